@@ -104,6 +104,8 @@ void Printer::visit(Class* class_ptr)
 
 void Printer::visit(Method* method_ptr)
 {
+  for (auto& decorator : method_ptr->decorators)
+    m_stream << '@' << decorator << '\n';
   m_stream << "method " << method_ptr->name << '(';
   auto iter = method_ptr->arguments.begin();
   if (iter != method_ptr->arguments.end()) {
@@ -160,8 +162,20 @@ void Printer::visit(If* if_ptr)
   m_stream << "end\n";
 }
 
+void printAnnotations(std::ostream& stream,
+  const std::vector<Annotation>& annotations)
+{
+  for (auto& annotation : annotations) {
+    stream << '@' << annotation.name;
+    if (annotation.argument)
+      stream << '(' << *annotation.argument << ')';
+    stream << '\n';
+  }
+}
+
 void Printer::visit(InfiniteLoop* infinite_loop_ptr)
 {
+  printAnnotations(m_stream, infinite_loop_ptr->annotations);
   m_stream << "do\n";
   for (auto& statement : infinite_loop_ptr->body)
     dispatch(statement.get(), this);
@@ -170,6 +184,7 @@ void Printer::visit(InfiniteLoop* infinite_loop_ptr)
 
 void Printer::visit(PreTestLoop* pre_test_loop_ptr)
 {
+  printAnnotations(m_stream, pre_test_loop_ptr->annotations);
   m_stream << "for ";
   dispatch(pre_test_loop_ptr->condition.get(), this);
   m_stream << '\n';
@@ -14,9 +14,11 @@
 #define BUCKET_ABSTRACT_SYNTAX_TREE_HXX
 
 #include "miscellaneous.hxx"
+#include "string_interner.hxx"
 #include <boost/noncopyable.hpp>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <string>
 #include <type_traits>
@@ -96,21 +98,22 @@ struct Global : Node {
 };
 
 struct Class final : Global {
-  std::string name;
+  InternedString name;
   std::vector<std::unique_ptr<Global>> globals;
   void receive(Visitor*) override;
 };
 
 struct Method final : Global {
-  std::string name;
-  std::vector<std::pair<std::string, std::unique_ptr<Expression>>> arguments;
+  std::vector<InternedString> decorators;
+  InternedString name;
+  std::vector<std::pair<InternedString, std::unique_ptr<Expression>>> arguments;
   std::unique_ptr<Expression> return_type;
   std::vector<std::unique_ptr<Statement>> statements;
   void receive(Visitor*) override;
 };
 
 struct Field final : Global {
-  std::string name;
+  InternedString name;
   std::unique_ptr<Expression> type;
   void receive(Visitor*) override;
 };
@@ -120,7 +123,7 @@ struct Statement : Node {
 };
 
 struct Declaration final : Statement {
-  std::string name;
+  InternedString name;
   std::unique_ptr<Expression> type;
   void receive(Visitor*) override;
 };
@@ -134,12 +137,22 @@ struct If final : Statement {
   void receive(Visitor*) override;
 };
 
+struct Annotation {
+  InternedString name;
+  std::optional<std::int64_t> argument;
+};
+// An annotation in front of a loop, like '@unroll(4)' or '@nounroll', which
+// tells the optimizer how to transform the loop. Method decorators are parsed
+// the same way but only their names are kept.
+
 struct InfiniteLoop final : Statement {
+  std::vector<Annotation> annotations;
   std::vector<std::unique_ptr<Statement>> body;
   void receive(Visitor*) override;
 };
 
 struct PreTestLoop final : Statement {
+  std::vector<Annotation> annotations;
   std::unique_ptr<Expression> condition;
   std::vector<std::unique_ptr<Statement>> body;
   std::vector<std::unique_ptr<Statement>> else_body;
@@ -175,13 +188,13 @@ struct Assignment final : Expression {
 
 struct Call final : Expression {
   std::unique_ptr<Expression> expression;
-  std::string name;
+  InternedString name;
   std::vector<std::unique_ptr<Expression>> arguments;
   void receive(Visitor*) override;
 };
 
 struct Identifier final : Expression {
-  std::string value;
+  InternedString value;
   void receive(Visitor*) override;
 };
 
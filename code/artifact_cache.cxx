@@ -0,0 +1,209 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "artifact_cache.hxx"
+#include "compiler_identity.hxx"
+#include "miscellaneous.hxx"
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+std::string errnoMessage()
+{
+  return std::error_code(errno, std::generic_category()).message();
+}
+
+// Creates the file to as a copy on write clone of the file from (which only
+// works on some file systems, like btrfs or xfs) with the given permissions.
+// Returns false if the file can't be cloned.
+bool reflink(const std::string& from, const std::string& to, mode_t mode)
+{
+  #ifdef FICLONE
+  int source = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (source < 0)
+    return false;
+  int destination = ::open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+    mode);
+  if (destination < 0) {
+    ::close(source);
+    return false;
+  }
+  bool cloned = ::ioctl(destination, FICLONE, source) == 0;
+  ::close(destination);
+  ::close(source);
+  if (!cloned)
+    ::unlink(to.c_str());
+  return cloned;
+  #else
+  static_cast<void>(from);
+  static_cast<void>(to);
+  static_cast<void>(mode);
+  return false;
+  #endif
+}
+
+// Creates the file to as a reflink of or else a copy of the file from, with the
+// given permissions
+void copy(const std::string& from, const std::string& to, mode_t mode)
+{
+  if (reflink(from, to, mode))
+    return;
+  if (auto error_code = llvm::sys::fs::copy_file(from, to))
+    throw make_error<GeneralError>("unable to copy '", from, "' to '", to,
+      "': ", error_code.message());
+  if (::chmod(to.c_str(), mode) != 0)
+    throw make_error<GeneralError>("unable to change the permissions of '", to,
+      "': ", errnoMessage());
+}
+
+mode_t permissions(const std::string& path)
+{
+  struct stat status;
+  if (::stat(path.c_str(), &status) != 0)
+    throw make_error<GeneralError>("unable to read '", path, "': ",
+      errnoMessage());
+  return status.st_mode & 07777;
+}
+
+}
+
+ArtifactCache::ArtifactCache(std::string directory)
+: m_directory{std::move(directory)}
+{
+  if (auto error_code = llvm::sys::fs::create_directories(m_directory))
+    throw make_error<GeneralError>("unable to create the cache '",
+      m_directory, "': ", error_code.message());
+}
+
+std::string ArtifactCache::key(const std::string& input_path,
+  const std::vector<std::string>& dependency_paths,
+  std::string_view flags) const
+{
+  llvm::MD5 md5;
+  auto update = [&md5](llvm::StringRef string) {
+    // prefix every part with its length, so that parts can't run into each
+    // other
+    auto length = std::to_string(string.size());
+    md5.update(length);
+    md5.update(":");
+    md5.update(string);
+  };
+  update("bucket artifact cache 1");
+  update(compilerIdentity());
+  update(llvm::StringRef(flags.data(), flags.size()));
+  auto updateFile = [&update](const std::string& path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer)
+      throw make_error<GeneralError>("unable to read '", path, "': ",
+        buffer.getError().message());
+    update((*buffer)->getBuffer());
+  };
+  updateFile(input_path);
+  for (auto& dependency_path : dependency_paths)
+    updateFile(dependency_path);
+  llvm::MD5::MD5Result result;
+  md5.final(result);
+  return result.digest().str().str();
+}
+
+ArtifactCache::Entry::Entry(const ArtifactCache& cache, const std::string& key)
+{
+  // entries are spread over subdirectories named after the first two digits
+  // of their keys, so that no directory gets too large
+  llvm::SmallString<128> path{cache.m_directory};
+  llvm::sys::path::append(path, key.substr(0, 2));
+  if (auto error_code = llvm::sys::fs::create_directories(path))
+    throw make_error<GeneralError>("unable to create '", path.str().str(),
+      "': ", error_code.message());
+  llvm::sys::path::append(path, key);
+  m_path = path.str().str();
+
+  auto lock_path = m_path + ".lock";
+  m_lock = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+  if (m_lock < 0)
+    throw make_error<GeneralError>("unable to open '", lock_path, "': ",
+      errnoMessage());
+  while (::flock(m_lock, LOCK_EX) != 0) {
+    if (errno != EINTR) {
+      auto message = errnoMessage();
+      ::close(m_lock);
+      throw make_error<GeneralError>("unable to lock '", lock_path, "': ",
+        message);
+    }
+  }
+}
+
+ArtifactCache::Entry::~Entry()
+{
+  // closing the file releases the lock
+  ::close(m_lock);
+}
+
+bool ArtifactCache::Entry::fetch(const std::string& output_path) const
+{
+  // An output which is a hard link into the cache (from an earlier hit) must
+  // never be written to, so a regular file at the output path is removed even
+  // on a miss. Anything else (like /dev/null) is left alone.
+  struct stat status;
+  if (::lstat(output_path.c_str(), &status) == 0 && S_ISREG(status.st_mode)
+    && ::unlink(output_path.c_str()) != 0)
+    throw make_error<GeneralError>("unable to remove '", output_path, "': ",
+      errnoMessage());
+  if (!llvm::sys::fs::exists(m_path))
+    return false;
+
+  // a reflink is a file of its own, so it gets the permissions of a regular
+  // output
+  auto mode = permissions(m_path) | S_IWUSR;
+  if (reflink(m_path, output_path, mode))
+    return true;
+  if (::link(m_path.c_str(), output_path.c_str()) == 0)
+    return true;
+  copy(m_path, output_path, mode);
+  return true;
+}
+
+void ArtifactCache::Entry::store(const std::string& output_path) const
+{
+  // The output is copied to a temporary file which is then renamed, which is
+  // atomic, so a crash never leaves a partial entry behind.
+  llvm::SmallString<128> temporary_path;
+  llvm::sys::fs::createUniquePath(m_path + ".%%%%%%.tmp", temporary_path,
+    false);
+  auto temporary = temporary_path.str().str();
+  try {
+    copy(output_path, temporary, permissions(output_path)
+      & ~(S_IWUSR | S_IWGRP | S_IWOTH));
+  }
+  catch (...) {
+    ::unlink(temporary.c_str());
+    throw;
+  }
+  if (::rename(temporary.c_str(), m_path.c_str()) != 0) {
+    auto message = errnoMessage();
+    ::unlink(temporary.c_str());
+    throw make_error<GeneralError>("unable to write to the cache: ", message);
+  }
+}
@@ -0,0 +1,73 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_ARTIFACT_CACHE_HXX
+#define BUCKET_ARTIFACT_CACHE_HXX
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ArtifactCache {
+// A content addressed directory of compiler outputs (llvm IR, bitcode,
+// assembly, object files or executables), in the style of ccache. Every output
+// is stored under a key hashing the contents of the input file and of the files
+// it depends on (the interface files it imports, the profile it is optimized
+// with and, for executables, the runtime and the startup files linked in), the
+// compiler (see compilerIdentity()) and the flags which affect the output.
+//
+// An entry is locked (with flock) while it is looked up and, on a miss, until
+// the output has been stored, so compilers running concurrently on the same
+// input wait for each other instead of doing the same work twice. Hits are
+// served as a reflink (a copy on write clone of the cached file) where the
+// file system supports it, as a hard link to the cached file otherwise and as
+// a copy as a last resort. Cached files are read-only, so outputs which are
+// hard links can't be modified in place by accident.
+
+public:
+
+  explicit ArtifactCache(std::string directory);
+  // Creates the directory if it doesn't exist yet.
+
+  std::string key(const std::string& input_path,
+    const std::vector<std::string>& dependency_paths,
+    std::string_view flags) const;
+
+  class Entry {
+  // An entry of the cache, which stays locked for as long as this exists.
+  public:
+    Entry(const ArtifactCache& cache, const std::string& key);
+    // Blocks until no other compiler holds the entry.
+    Entry(const Entry&) = delete;
+    Entry& operator=(const Entry&) = delete;
+    ~Entry();
+
+    bool fetch(const std::string& output_path) const;
+    // Replaces the file at output_path with the cached output. Returns false if
+    // the entry is empty, in which case a regular file at output_path is only
+    // removed.
+
+    void store(const std::string& output_path) const;
+    // Puts the file at output_path into the cache.
+
+  private:
+    std::string m_path;
+    int m_lock;
+  };
+
+private:
+
+  std::string m_directory;
+
+};
+
+#endif
@@ -0,0 +1,20 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "builtin_bitcode.hxx"
+
+// builtin.bc.inc is generated by the build with xxd -i
+const unsigned char builtin_bitcode[] = {
+  #include "builtin.bc.inc"
+};
+
+const std::size_t builtin_bitcode_size = sizeof(builtin_bitcode);
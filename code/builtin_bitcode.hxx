@@ -0,0 +1,25 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_BUILTIN_BITCODE_HXX
+#define BUCKET_BUILTIN_BITCODE_HXX
+
+#include <cstddef>
+
+extern const unsigned char builtin_bitcode[];
+extern const std::size_t builtin_bitcode_size;
+// The runtime (builtin.cxx) compiled to llvm bitcode. The build compiles the
+// runtime with clang and embeds the bitcode in the compiler, so that the code
+// generator can link the runtime into the program and optimize across the
+// boundary.
+
+#endif
@@ -11,6 +11,8 @@
 // GNU General Public License for more details.
 
 #include "code_generator.hxx"
+#include "builtin_bitcode.hxx"
+#include "interface_file.hxx"
 #include "miscellaneous.hxx"
 #include <algorithm>
 #include <boost/bimap.hpp>
@@ -18,36 +20,354 @@
 #include <boost/graph/exception.hpp>
 #include <boost/graph/topological_sort.hpp>
 #include <boost/polymorphic_cast.hpp>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
 #include <initializer_list>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringSet.h>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/Bitcode/BitcodeReader.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/InstrProfReader.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#if LLVM_VERSION_MAJOR >= 14
+#include <llvm/MC/TargetRegistry.h>
+#else
+#include <llvm/Support/TargetRegistry.h>
+#endif
+#include <map>
 #include <memory>
+#include <set>
+#include <sstream>
 #include <string>
 #include <string_view>
 #include <system_error>
 #include <utility>
 #include <vector>
 
-CodeGenerator::CodeGenerator()
+namespace {
+
+// Creates a target machine for the host's architecture and the given cpu. The
+// native target is only registered with llvm once per process.
+std::unique_ptr<llvm::TargetMachine> createTargetMachine(const Target& target)
+{
+  static bool initialized = [] {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    return true;
+  }();
+  static_cast<void>(initialized);
+
+  auto triple = llvm::sys::getDefaultTargetTriple();
+  std::string error_message;
+  auto llvm_target = llvm::TargetRegistry::lookupTarget(triple, error_message);
+  if (!llvm_target)
+    throw make_error<CodeGeneratorError>("unable to find target '", triple,
+      "': ", error_message);
+
+  // llvm only warns about unknown cpus (and then ignores them)
+  std::unique_ptr<llvm::MCSubtargetInfo> subtarget_info{
+    llvm_target->createMCSubtargetInfo(triple, "", "")};
+  for (auto& cpu : {target.cpu, target.tune_cpu})
+    if (!cpu.empty() && !subtarget_info->isCPUStringValid(cpu))
+      throw make_error<CodeGeneratorError>("unknown processor '", cpu,
+        "' for target '", triple, '\'');
+
+  return std::unique_ptr<llvm::TargetMachine>{llvm_target->createTargetMachine(
+    triple, target.cpu, target.features, llvm::TargetOptions{},
+    llvm::Reloc::PIC_)};
+}
+
+// Makes a function be compiled for the given target, whatever target machine
+// compiles it
+void setTargetAttributes(llvm::Function& function, const Target& target)
+{
+  function.addFnAttr("target-cpu", target.cpu);
+  if (!target.features.empty())
+    function.addFnAttr("target-features", target.features);
+  #if LLVM_VERSION_MAJOR >= 12
+  if (!target.tune_cpu.empty())
+    function.addFnAttr("tune-cpu", target.tune_cpu);
+  #endif
+}
+
+llvm::CodeGenOpt::Level codeGenOptLevel(OptimizationLevel level)
+{
+  switch (level) {
+    case OptimizationLevel::O0:
+      return llvm::CodeGenOpt::None;
+    case OptimizationLevel::O1:
+      return llvm::CodeGenOpt::Less;
+    case OptimizationLevel::O2:
+    case OptimizationLevel::Os:
+      return llvm::CodeGenOpt::Default;
+    case OptimizationLevel::O3:
+      return llvm::CodeGenOpt::Aggressive;
+  }
+  BUCKET_UNREACHABLE();
+  return llvm::CodeGenOpt::None;
+}
+
+// Runs llvm's default optimization pipeline for the given level (above O0),
+// which also instruments the module or reads the profile (see Profile)
+void runPipeline(llvm::Module& module, llvm::TargetMachine& target_machine,
+  OptimizationLevel level, const Profile& profile)
+{
+  #if LLVM_VERSION_MAJOR >= 14
+  using LLVMOptimizationLevel = llvm::OptimizationLevel;
+  #else
+  using LLVMOptimizationLevel = llvm::PassBuilder::OptimizationLevel;
+  #endif
+
+  // The built-in operators are lowered to instructions and the rest of the
+  // runtime is inlined, so loops over ints and reals are plain arithmetic
+  // which the vectorizers handle well. Like clang, O2 and O3 unroll and
+  // vectorize loops (for the cpu of the target, see createTargetMachine()) and
+  // run the SLP vectorizer. O1 leaves all of that out to compile quickly and Os
+  // to keep the code small.
+  llvm::PipelineTuningOptions tuning_options;
+  LLVMOptimizationLevel llvm_level;
+  switch (level) {
+    case OptimizationLevel::O0:
+      BUCKET_UNREACHABLE();
+      return;
+    case OptimizationLevel::O1:
+      llvm_level = LLVMOptimizationLevel::O1;
+      tuning_options.LoopUnrolling = false;
+      tuning_options.LoopVectorization = false;
+      tuning_options.LoopInterleaving = false;
+      tuning_options.SLPVectorization = false;
+      break;
+    case OptimizationLevel::O2:
+      llvm_level = LLVMOptimizationLevel::O2;
+      tuning_options.LoopUnrolling = true;
+      tuning_options.LoopVectorization = true;
+      tuning_options.LoopInterleaving = true;
+      tuning_options.SLPVectorization = true;
+      break;
+    case OptimizationLevel::O3:
+      llvm_level = LLVMOptimizationLevel::O3;
+      tuning_options.LoopUnrolling = true;
+      tuning_options.LoopVectorization = true;
+      tuning_options.LoopInterleaving = true;
+      tuning_options.SLPVectorization = true;
+      break;
+    case OptimizationLevel::Os:
+      llvm_level = LLVMOptimizationLevel::Os;
+      tuning_options.LoopUnrolling = false;
+      tuning_options.LoopVectorization = false;
+      tuning_options.LoopInterleaving = false;
+      tuning_options.SLPVectorization = false;
+      break;
+  }
+
+  // The instrumentation is added after the early simplification of the
+  // pipeline, so that it counts the edges of the simplified code, and the
+  // counters are lowered to the sections the runtime reads (see
+  // profile_runtime.cxx). A profile is read at the same point, so the inliner
+  // and everything after it (e.g. block placement and the splitting of cold
+  // code) see its counts.
+  #if LLVM_VERSION_MAJOR >= 16
+  std::optional<llvm::PGOOptions> pgo_options;
+  #else
+  llvm::Optional<llvm::PGOOptions> pgo_options;
+  #endif
+  #if LLVM_VERSION_MAJOR >= 17
+  auto file_system = llvm::vfs::getRealFileSystem();
+  if (profile.mode == Profile::Mode::Generate)
+    pgo_options = llvm::PGOOptions{profile.path, "", "", "", file_system,
+      llvm::PGOOptions::IRInstr};
+  else if (profile.mode == Profile::Mode::Use)
+    pgo_options = llvm::PGOOptions{profile.path, "", "", "", file_system,
+      llvm::PGOOptions::IRUse};
+  #else
+  if (profile.mode == Profile::Mode::Generate)
+    pgo_options = llvm::PGOOptions{profile.path, "", "",
+      llvm::PGOOptions::IRInstr};
+  else if (profile.mode == Profile::Mode::Use)
+    pgo_options = llvm::PGOOptions{profile.path, "", "",
+      llvm::PGOOptions::IRUse};
+  #endif
+
+  #if LLVM_VERSION_MAJOR >= 13
+  llvm::PassBuilder pass_builder{&target_machine, tuning_options, pgo_options};
+  #else
+  llvm::PassBuilder pass_builder{false, &target_machine, tuning_options,
+    pgo_options};
+  #endif
+  llvm::LoopAnalysisManager loop_analysis_manager;
+  llvm::FunctionAnalysisManager function_analysis_manager;
+  llvm::CGSCCAnalysisManager cgscc_analysis_manager;
+  llvm::ModuleAnalysisManager module_analysis_manager;
+  pass_builder.registerModuleAnalyses(module_analysis_manager);
+  pass_builder.registerCGSCCAnalyses(cgscc_analysis_manager);
+  pass_builder.registerFunctionAnalyses(function_analysis_manager);
+  pass_builder.registerLoopAnalyses(loop_analysis_manager);
+  pass_builder.crossRegisterProxies(loop_analysis_manager,
+    function_analysis_manager, cgscc_analysis_manager, module_analysis_manager);
+  auto module_pass_manager = pass_builder.buildPerModuleDefaultPipeline(
+    llvm_level);
+  module_pass_manager.run(module, module_analysis_manager);
+}
+
+// Checks that a profile can be read before the pipeline does, which reports
+// errors by exiting
+void checkProfile(const std::string& path)
+{
+  #if LLVM_VERSION_MAJOR >= 17
+  auto file_system = llvm::vfs::getRealFileSystem();
+  auto reader = llvm::IndexedInstrProfReader::create(path, *file_system);
+  #else
+  auto reader = llvm::IndexedInstrProfReader::create(path);
+  #endif
+  if (!reader)
+    throw make_error<CodeGeneratorError>("unable to read the profile '", path,
+      "': ", llvm::toString(reader.takeError()));
+}
+
+// Makes an instrumented module reference the variable which pulls the profile
+// runtime in (see profile_runtime.cxx). The instrumentation only does so itself
+// on targets other than linux, where clang links the runtime by other means.
+// Like there, the reference is a hidden function nothing calls, which is kept
+// by llvm.compiler.used and merged into one by the linker.
+void referenceProfileRuntime(llvm::Module& module)
+{
+  auto name = llvm::getInstrProfRuntimeHookVarName();
+  if (module.getNamedValue(name))
+    return;
+  auto int32_type = llvm::Type::getInt32Ty(module.getContext());
+  auto runtime = new llvm::GlobalVariable{module, int32_type, false,
+    llvm::GlobalValue::ExternalLinkage, nullptr, name};
+  runtime->setVisibility(llvm::GlobalValue::HiddenVisibility);
+  auto user = llvm::Function::Create(llvm::FunctionType::get(int32_type,
+    false), llvm::GlobalValue::LinkOnceODRLinkage,
+    llvm::getInstrProfRuntimeHookVarUseFuncName(), module);
+  user->setVisibility(llvm::GlobalValue::HiddenVisibility);
+  user->addFnAttr(llvm::Attribute::NoInline);
+  llvm::IRBuilder<> builder{llvm::BasicBlock::Create(module.getContext(),
+    "entry", user)};
+  builder.CreateRet(builder.CreateLoad(int32_type, runtime));
+  llvm::appendToCompilerUsed(module, {user});
+}
+
+// Links the functions of the runtime used by a module into it (see
+// CodeGenerator::optimize())
+void linkRuntime(llvm::Module& module, const Target& target)
+{
+  auto runtime = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(
+    reinterpret_cast<const char*>(builtin_bitcode), builtin_bitcode_size),
+    "builtin"), module.getContext());
+  if (!runtime)
+    throw make_error<CodeGeneratorError>("unable to read the runtime: ",
+      llvm::toString(runtime.takeError()));
+  (*runtime)->setTargetTriple(module.getTargetTriple());
+  (*runtime)->setDataLayout(module.getDataLayout());
+
+  // the runtime was compiled for a generic cpu, compile it for the same target
+  // as the program instead (this also keeps the inliner from refusing to inline
+  // it because of mismatching target features)
+  for (auto& function : **runtime) {
+    function.removeFnAttr("target-cpu");
+    function.removeFnAttr("target-features");
+    function.removeFnAttr("tune-cpu");
+    if (!function.isDeclaration())
+      setTargetAttributes(function, target);
+  }
+
+  // only the runtime functions the program uses are linked, and they become
+  // internal so that the optimizer may inline them and drop the rest
+  if (llvm::Linker::linkModules(module, std::move(*runtime),
+    llvm::Linker::Flags::LinkOnlyNeeded,
+    [](llvm::Module& module, const llvm::StringSet<>& linked_names) {
+      llvm::internalizeModule(module, [&linked_names](
+        const llvm::GlobalValue& value) {
+        return !value.hasName() || !linked_names.count(value.getName());
+      });
+    }))
+    throw make_error<CodeGeneratorError>("unable to link the runtime");
+}
+
+// Compiles a module into an object file
+void emitObject(llvm::TargetMachine& target_machine, llvm::Module& module,
+  llvm::SmallString<0>& object)
+{
+  llvm::raw_svector_ostream stream{object};
+  llvm::legacy::PassManager pass_manager;
+  if (target_machine.addPassesToEmitFile(pass_manager, stream, nullptr,
+    llvm::CGFT_ObjectFile))
+    throw make_error<CodeGeneratorError>("the target can't emit object files");
+  pass_manager.run(module);
+}
+
+// Reads a module which was moved to another context as bitcode
+std::unique_ptr<llvm::Module> parseModule(llvm::StringRef bitcode,
+  llvm::LLVMContext& context, const char* name)
+{
+  auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, name),
+    context);
+  if (!module)
+    throw make_error<CodeGeneratorError>("unable to read ", name, ": ",
+      llvm::toString(module.takeError()));
+  return std::move(*module);
+}
+
+}
+
+CodeGenerator::CodeGenerator(std::size_t shard, std::size_t shard_count,
+  Target target)
 : m_symbol_table{},
-  m_context{},
-  m_module{"bucket-llvm-module", m_context},
-  m_ir_builder{m_context}
-{}
+  m_target{std::move(target)},
+  m_target_machine{createTargetMachine(m_target)},
+  m_context{std::make_unique<llvm::LLVMContext>()},
+  m_module{std::make_unique<llvm::Module>("bucket-llvm-module", *m_context)},
+  m_ir_builder{*m_context},
+  m_current_class{nullptr},
+  m_current_method{nullptr},
+  m_loop_entry_block{nullptr},
+  m_loop_merge_block{nullptr},
+  m_loop_id{nullptr},
+  m_shard{shard},
+  m_shard_count{shard_count},
+  m_method_count{0},
+  m_method_cache{nullptr}
+{
+  BUCKET_ASSERT(shard < shard_count);
+  m_module->setTargetTriple(m_target_machine->getTargetTriple().str());
+  m_module->setDataLayout(m_target_machine->createDataLayout());
+}
 
 void CodeGenerator::printIR(std::optional<std::string> output_path)
 {
   std::string name = output_path ? *output_path : std::string("-");
   std::error_code error_code;
   llvm::raw_fd_ostream ostream{llvm::StringRef(name.data(), name.size()), error_code};
-  m_module.print(ostream, nullptr);
+  m_module->print(ostream, nullptr);
   if (error_code)
     throw make_error<CodeGeneratorError>("unable to print IR to file: ", error_code.message());
 }
@@ -57,11 +377,326 @@ void CodeGenerator::printBC(std::optional<std::string> output_path)
   std::string name = output_path ? *output_path : std::string("-");
   std::error_code error_code;
   llvm::raw_fd_ostream ostream{llvm::StringRef(name.data(), name.size()), error_code};
-  llvm::WriteBitcodeToFile(m_module, ostream);
+  llvm::WriteBitcodeToFile(*m_module, ostream);
   if (error_code)
     throw make_error<CodeGeneratorError>("unable to print IR to file: ", error_code.message());
 }
 
+void CodeGenerator::printAssembly(std::optional<std::string> output_path)
+{
+  printNative(std::move(output_path), llvm::CGFT_AssemblyFile);
+}
+
+void CodeGenerator::printObject(std::optional<std::string> output_path)
+{
+  printNative(std::move(output_path), llvm::CGFT_ObjectFile);
+}
+
+std::vector<llvm::SmallString<0>> CodeGenerator::compileObjects(unsigned jobs)
+{
+  // Partitions get at least this many functions, so that small modules aren't
+  // split at all
+  constexpr std::size_t functions_per_partition = 64;
+  constexpr std::size_t max_partitions = 16;
+
+  auto definitions = static_cast<std::size_t>(std::count_if(
+    m_module->begin(), m_module->end(),
+    [](llvm::Function& function){return !function.isDeclaration();}));
+  auto partition_count = std::min(definitions / functions_per_partition,
+    max_partitions);
+  if (partition_count <= 1) {
+    std::vector<llvm::SmallString<0>> objects(1);
+    emitObject(*m_target_machine, *m_module, objects[0]);
+    return objects;
+  }
+
+  // Contexts can't be used from several threads at once, so every partition
+  // is moved to a context of its own as bitcode (like llvm::splitCodeGen
+  // does).
+  std::vector<llvm::SmallString<0>> partitions;
+  auto addPartition = [&partitions](std::unique_ptr<llvm::Module> partition) {
+    llvm::raw_svector_ostream stream{partitions.emplace_back()};
+    llvm::WriteBitcodeToFile(*partition, stream);
+  };
+  #if LLVM_VERSION_MAJOR >= 13
+  llvm::SplitModule(*m_module, static_cast<unsigned>(partition_count),
+    addPartition);
+  #else
+  llvm::SplitModule(llvm::CloneModule(*m_module),
+    static_cast<unsigned>(partition_count), addPartition);
+  #endif
+
+  std::vector<llvm::SmallString<0>> objects(partitions.size());
+  auto opt_level = m_target_machine->getOptLevel();
+  parallelFor(partitions.size(), jobs, [&](std::size_t index) {
+    llvm::LLVMContext context;
+    auto module = parseModule(partitions[index], context, "partition");
+    auto target_machine = createTargetMachine(m_target);
+    target_machine->setOptLevel(opt_level);
+    emitObject(*target_machine, *module, objects[index]);
+  });
+  return objects;
+}
+
+std::vector<llvm::SmallString<0>> CodeGenerator::compileMethods(
+  OptimizationLevel level, unsigned jobs)
+{
+  BUCKET_ASSERT(m_method_cache);
+
+  // Every function defined in the module is cloned into a module of its own in
+  // which all other functions are only declared. Like the partitions in
+  // compileObjects() the clones are moved to contexts of their own as bitcode,
+  // so that they can be compiled concurrently.
+  std::vector<llvm::SmallString<0>> objects;
+  std::vector<llvm::SmallString<0>> units;
+  std::vector<std::size_t> unit_objects;
+  std::vector<const std::string*> unit_keys;
+  for (auto& function : *m_module) {
+    auto key = m_method_keys.find(function.getName().str());
+    if (function.isDeclaration()) {
+      if (key != m_method_keys.end())
+        objects.push_back(m_method_cache->load(key->second));
+      continue;
+    }
+    llvm::ValueToValueMapTy value_map;
+    auto unit = llvm::CloneModule(*m_module, value_map,
+      [&function](const llvm::GlobalValue* value) {return value == &function;});
+    llvm::raw_svector_ostream stream{units.emplace_back()};
+    llvm::WriteBitcodeToFile(*unit, stream);
+    unit_objects.push_back(objects.size());
+    objects.emplace_back();
+    // the entry point has no key, but it is cheap to compile
+    unit_keys.push_back(key != m_method_keys.end() ? &key->second : nullptr);
+  }
+
+  parallelFor(units.size(), jobs, [&](std::size_t index) {
+    llvm::LLVMContext context;
+    auto module = parseModule(units[index], context, "method");
+    auto target_machine = createTargetMachine(m_target);
+    target_machine->setOptLevel(codeGenOptLevel(level));
+    if (level != OptimizationLevel::O0) {
+      linkRuntime(*module, m_target);
+      runPipeline(*module, *target_machine, level, Profile{});
+    }
+    auto& object = objects[unit_objects[index]];
+    emitObject(*target_machine, *module, object);
+    if (unit_keys[index])
+      m_method_cache->store(*unit_keys[index], object.str());
+  });
+  return objects;
+}
+
+void CodeGenerator::printNative(std::optional<std::string> output_path,
+  llvm::CodeGenFileType file_type)
+{
+  std::string name = output_path ? *output_path : std::string("-");
+  std::error_code error_code;
+  llvm::raw_fd_ostream ostream{llvm::StringRef(name.data(), name.size()), error_code};
+  if (error_code)
+    throw make_error<CodeGeneratorError>("unable to open output file: ", error_code.message());
+  llvm::legacy::PassManager pass_manager;
+  if (m_target_machine->addPassesToEmitFile(pass_manager, ostream, nullptr,
+    file_type))
+    throw make_error<CodeGeneratorError>("the target can't emit a file of this "
+      "type");
+  pass_manager.run(*m_module);
+  ostream.flush();
+  if (ostream.has_error())
+    throw make_error<CodeGeneratorError>("unable to write output file: ", ostream.error().message());
+}
+
+void CodeGenerator::linkShard(CodeGenerator& shard)
+{
+  // modules can only be linked within a single context, so the module of the
+  // shard is moved over as bitcode
+  llvm::SmallVector<char, 0> buffer;
+  {
+    auto [context, module] = shard.releaseModule();
+    llvm::raw_svector_ostream stream{buffer};
+    llvm::WriteBitcodeToFile(*module, stream);
+  }
+  auto module = parseModule(llvm::StringRef(buffer.data(), buffer.size()),
+    *m_context, "shard");
+  std::vector<std::string> function_order;
+  for (auto& function : *m_module)
+    function_order.push_back(function.getName().str());
+  if (llvm::Linker::linkModules(*m_module, std::move(module)))
+    throw make_error<CodeGeneratorError>("unable to link shard");
+  m_method_keys.merge(shard.m_method_keys);
+
+  // The linker replaces the declarations of the methods defined by the shard
+  // with new functions at the end of the module. Put them back in the order of
+  // the program (the other globals of the shard stay where the linker put
+  // them).
+  for (auto& name : function_order) {
+    auto function = m_module->getFunction(name);
+    function->removeFromParent();
+    m_module->getFunctionList().push_back(function);
+  }
+}
+
+std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>>
+CodeGenerator::releaseModule()
+{
+  return {std::move(m_context), std::move(m_module)};
+}
+
+void CodeGenerator::optimize(OptimizationLevel level, const Profile& profile)
+{
+  m_target_machine->setOptLevel(codeGenOptLevel(level));
+  if (level == OptimizationLevel::O0)
+    return;
+  if (profile.mode == Profile::Mode::Use)
+    checkProfile(profile.path);
+  linkRuntime(*m_module, m_target);
+  runPipeline(*m_module, *m_target_machine, level, profile);
+  if (profile.mode == Profile::Mode::Generate)
+    referenceProfileRuntime(*m_module);
+}
+
+namespace {
+
+// Decides how the receiver of a method is passed. The receivers of methods on
+// classes are passed by pointer, everything else (bool, int, real, byte and
+// pointers) is passed by value, which for the built-in types matches the
+// signatures in builtin.hxx.
+bool passedByPointer(SymbolTable::Type* type)
+{
+  return SymbolTable::sym_cast<SymbolTable::Class*>(type) != nullptr;
+}
+
+// Lowerings of built-in methods (see SymbolTable::Method). arguments[0] is the
+// value of the receiver. They behave like the runtime functions they replace,
+// which with BUCKET_BUILTIN_UBCHECK abort on undefined behavior: int
+// arithmetic then traps on overflow and wraps around otherwise. Integer
+// division, modulo and the byte shifts are not lowered, so they are still
+// checked by the runtime. A lowering may branch, but has to continue in a
+// block whose only predecessor is the block it started in.
+
+using Arguments = std::vector<llvm::Value*>;
+
+llvm::Value* lowerAnd(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateAnd(arguments[0], arguments[1]);
+}
+
+llvm::Value* lowerOr(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateOr(arguments[0], arguments[1]);
+}
+
+llvm::Value* lowerXor(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateXor(arguments[0], arguments[1]);
+}
+
+llvm::Value* lowerNot(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateNot(arguments[0]);
+}
+
+#ifdef BUCKET_BUILTIN_UBCHECK
+// Emits an arithmetic intrinsic with overflow (like llvm.sadd.with.overflow)
+// which traps if the operation overflows
+llvm::Value* lowerChecked(llvm::IRBuilderBase& ir_builder,
+  llvm::Intrinsic::ID intrinsic, const Arguments& arguments)
+{
+  auto result = ir_builder.CreateBinaryIntrinsic(intrinsic, arguments[0],
+    arguments[1]);
+  auto& context = ir_builder.getContext();
+  auto function = ir_builder.GetInsertBlock()->getParent();
+  auto overflow_block = llvm::BasicBlock::Create(context, "$overflow",
+    function);
+  auto no_overflow_block = llvm::BasicBlock::Create(context, "$no_overflow",
+    function);
+  ir_builder.CreateCondBr(ir_builder.CreateExtractValue(result, 1),
+    overflow_block, no_overflow_block,
+    llvm::MDBuilder{context}.createBranchWeights(1, 1 << 20));
+  ir_builder.SetInsertPoint(overflow_block);
+  ir_builder.CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+  ir_builder.CreateUnreachable();
+  ir_builder.SetInsertPoint(no_overflow_block);
+  return ir_builder.CreateExtractValue(result, 0);
+}
+#endif
+
+llvm::Value* lowerAdd(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  #ifdef BUCKET_BUILTIN_UBCHECK
+  return lowerChecked(ir_builder, llvm::Intrinsic::sadd_with_overflow,
+    arguments);
+  #else
+  return ir_builder.CreateAdd(arguments[0], arguments[1]);
+  #endif
+}
+
+llvm::Value* lowerSub(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  #ifdef BUCKET_BUILTIN_UBCHECK
+  return lowerChecked(ir_builder, llvm::Intrinsic::ssub_with_overflow,
+    arguments);
+  #else
+  return ir_builder.CreateSub(arguments[0], arguments[1]);
+  #endif
+}
+
+llvm::Value* lowerMul(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  #ifdef BUCKET_BUILTIN_UBCHECK
+  return lowerChecked(ir_builder, llvm::Intrinsic::smul_with_overflow,
+    arguments);
+  #else
+  return ir_builder.CreateMul(arguments[0], arguments[1]);
+  #endif
+}
+
+template <llvm::CmpInst::Predicate predicate>
+llvm::Value* lowerICmp(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateICmp(predicate, arguments[0], arguments[1]);
+}
+
+llvm::Value* lowerFAdd(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateFAdd(arguments[0], arguments[1]);
+}
+
+llvm::Value* lowerFSub(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateFSub(arguments[0], arguments[1]);
+}
+
+llvm::Value* lowerFMul(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateFMul(arguments[0], arguments[1]);
+}
+
+llvm::Value* lowerFDiv(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateFDiv(arguments[0], arguments[1]);
+}
+
+template <llvm::CmpInst::Predicate predicate>
+llvm::Value* lowerFCmp(llvm::IRBuilderBase& ir_builder,
+  const Arguments& arguments)
+{
+  return ir_builder.CreateFCmp(predicate, arguments[0], arguments[1]);
+}
+
+}
+
 void CodeGenerator::initializeBuiltins()
 {
   // function to help create built-in methods
@@ -70,11 +705,12 @@ void CodeGenerator::initializeBuiltins()
     std::string_view name,
     std::initializer_list<SymbolTable::Type*> args,
     SymbolTable::Type* return_type,
-    std::string_view link_name
+    std::string_view link_name,
+    SymbolTable::Method::Lowering lowering = nullptr
   ) {
     std::vector<SymbolTable::Type*> sym_args{args};
     std::vector<llvm::Type*> llvm_args{sym_args.size() + 1};
-    llvm_args[0] = m_symbol_table.getPointerType(type)->m_llvm_type;
+    llvm_args[0] = type->m_llvm_type;
     std::transform(sym_args.begin(), sym_args.end(), llvm_args.begin() + 1,
       [](SymbolTable::Type* typ){return typ->m_llvm_type;});
     auto method_entry = m_symbol_table.createMethod(name, std::move(sym_args),
@@ -82,7 +718,12 @@ void CodeGenerator::initializeBuiltins()
     method_entry->m_llvm_function = llvm::Function::Create(llvm::FunctionType::get(
       return_type->m_llvm_type, llvm_args, false),
       llvm::Function::ExternalLinkage, llvm::StringRef(link_name.data(),
-      link_name.size()), m_module);
+      link_name.size()), *m_module);
+    // the runtime takes bools and bytes as zero extended C++ values
+    for (unsigned i = 0; i != llvm_args.size(); ++i)
+      if (llvm_args[i]->isIntegerTy(1) || llvm_args[i]->isIntegerTy(8))
+        method_entry->m_llvm_function->addParamAttr(i, llvm::Attribute::ZExt);
+    method_entry->m_lowering = lowering;
   };
 
   // function to help create built-in system calls
@@ -101,9 +742,11 @@ void CodeGenerator::initializeBuiltins()
     method_entry->m_llvm_function = llvm::Function::Create(llvm::FunctionType::get(
       return_type->m_llvm_type, llvm_args, false),
       llvm::Function::ExternalLinkage, llvm::StringRef(link_name.data(),
-      link_name.size()), m_module);
+      link_name.size()), *m_module);
   };
 
+  using Predicate = llvm::CmpInst::Predicate;
+
   // create built-in types
   auto bool_type = m_symbol_table.createType("bool", m_ir_builder.getInt1Ty());
   auto int_type = m_symbol_table.createType("int", m_ir_builder.getInt64Ty());
@@ -114,44 +757,67 @@ void CodeGenerator::initializeBuiltins()
 
   // create built-in methods
   m_symbol_table.pushScope("bool");
-  method(bool_type, "__and__", {bool_type}, bool_type, "bucket_bool_and");
-  method(bool_type, "__or__", {bool_type}, bool_type, "bucket_bool_or");
-  method(bool_type, "__not__", {}, bool_type, "bucket_bool_not");
+  method(bool_type, "__and__", {bool_type}, bool_type, "bucket_bool_and",
+    lowerAnd);
+  method(bool_type, "__or__", {bool_type}, bool_type, "bucket_bool_or",
+    lowerOr);
+  method(bool_type, "__not__", {}, bool_type, "bucket_bool_not", lowerNot);
   method(bool_type, "print", {}, nil_type, "bucket_bool_print");
   m_symbol_table.popScope();
 
   m_symbol_table.pushScope("int");
-  method(int_type, "__add__", {int_type}, int_type, "bucket_int_add");
-  method(int_type, "__sub__", {int_type}, int_type, "bucket_int_sub");
-  method(int_type, "__mul__", {int_type}, int_type, "bucket_int_mul");
+  method(int_type, "__add__", {int_type}, int_type, "bucket_int_add", lowerAdd);
+  method(int_type, "__sub__", {int_type}, int_type, "bucket_int_sub", lowerSub);
+  method(int_type, "__mul__", {int_type}, int_type, "bucket_int_mul", lowerMul);
   method(int_type, "__div__", {int_type}, int_type, "bucket_int_div");
   method(int_type, "__mod__", {int_type}, int_type, "bucket_int_mod");
-  method(int_type, "__lt__", {int_type}, bool_type, "bucket_int_lt");
-  method(int_type, "__le__", {int_type}, bool_type, "bucket_int_le");
-  method(int_type, "__eq__", {int_type}, bool_type, "bucket_int_eq");
-  method(int_type, "__gt__", {int_type}, bool_type, "bucket_int_ge");
-  method(int_type, "__ge__", {int_type}, bool_type, "bucket_int_gt");
+  method(int_type, "__lt__", {int_type}, bool_type, "bucket_int_lt",
+    lowerICmp<Predicate::ICMP_SLT>);
+  method(int_type, "__le__", {int_type}, bool_type, "bucket_int_le",
+    lowerICmp<Predicate::ICMP_SLE>);
+  method(int_type, "__eq__", {int_type}, bool_type, "bucket_int_eq",
+    lowerICmp<Predicate::ICMP_EQ>);
+  method(int_type, "__neq__", {int_type}, bool_type, "bucket_int_ne",
+    lowerICmp<Predicate::ICMP_NE>);
+  method(int_type, "__gt__", {int_type}, bool_type, "bucket_int_gt",
+    lowerICmp<Predicate::ICMP_SGT>);
+  method(int_type, "__ge__", {int_type}, bool_type, "bucket_int_ge",
+    lowerICmp<Predicate::ICMP_SGE>);
   method(int_type, "print", {}, nil_type, "bucket_int_print");
   m_symbol_table.popScope();
 
   m_symbol_table.pushScope("real");
-  method(real_type, "__add__", {real_type}, real_type, "bucket_real_add");
-  method(real_type, "__sub__", {real_type}, real_type, "bucket_real_sub");
-  method(real_type, "__mul__", {real_type}, real_type, "bucket_real_mul");
-  method(real_type, "__div__", {real_type}, real_type, "bucket_real_div");
-  method(real_type, "__lt__", {real_type}, bool_type, "bucket_real_lt");
-  method(real_type, "__le__", {real_type}, bool_type, "bucket_real_le");
-  method(real_type, "__eq__", {real_type}, bool_type, "bucket_real_eq");
-  method(real_type, "__gt__", {real_type}, bool_type, "bucket_real_ge");
-  method(real_type, "__ge__", {real_type}, bool_type, "bucket_real_gt");
+  method(real_type, "__add__", {real_type}, real_type, "bucket_real_add",
+    lowerFAdd);
+  method(real_type, "__sub__", {real_type}, real_type, "bucket_real_sub",
+    lowerFSub);
+  method(real_type, "__mul__", {real_type}, real_type, "bucket_real_mul",
+    lowerFMul);
+  method(real_type, "__div__", {real_type}, real_type, "bucket_real_div",
+    lowerFDiv);
+  method(real_type, "__lt__", {real_type}, bool_type, "bucket_real_lt",
+    lowerFCmp<Predicate::FCMP_OLT>);
+  method(real_type, "__le__", {real_type}, bool_type, "bucket_real_le",
+    lowerFCmp<Predicate::FCMP_OLE>);
+  method(real_type, "__eq__", {real_type}, bool_type, "bucket_real_eq",
+    lowerFCmp<Predicate::FCMP_OEQ>);
+  method(real_type, "__neq__", {real_type}, bool_type, "bucket_real_ne",
+    lowerFCmp<Predicate::FCMP_UNE>);
+  method(real_type, "__gt__", {real_type}, bool_type, "bucket_real_gt",
+    lowerFCmp<Predicate::FCMP_OGT>);
+  method(real_type, "__ge__", {real_type}, bool_type, "bucket_real_ge",
+    lowerFCmp<Predicate::FCMP_OGE>);
   method(real_type, "print", {}, nil_type, "bucket_real_print");
   m_symbol_table.popScope();
 
   m_symbol_table.pushScope("byte");
-  method(byte_type, "__and__", {byte_type}, byte_type, "bucket_byte_and");
-  method(byte_type, "__or__", {byte_type}, byte_type, "bucket_byte_or");
-  method(byte_type, "__xor__", {byte_type}, byte_type, "bucket_byte_xor");
-  method(byte_type, "__not__", {}, byte_type, "bucket_byte_not");
+  method(byte_type, "__and__", {byte_type}, byte_type, "bucket_byte_and",
+    lowerAnd);
+  method(byte_type, "__or__", {byte_type}, byte_type, "bucket_byte_or",
+    lowerOr);
+  method(byte_type, "__xor__", {byte_type}, byte_type, "bucket_byte_xor",
+    lowerXor);
+  method(byte_type, "__not__", {}, byte_type, "bucket_byte_not", lowerNot);
   method(byte_type, "__lshift__", {int_type}, byte_type, "bucket_byte_lshift");
   method(byte_type, "__rshift__", {int_type}, byte_type, "bucket_byte_rshift");
   method(byte_type, "print", {}, nil_type, "bucket_byte_print");
@@ -162,6 +828,349 @@ void CodeGenerator::initializeBuiltins()
   m_symbol_table.popScope();
 }
 
+void CodeGenerator::importInterface(std::string path)
+{
+  m_interface_paths.push_back(std::move(path));
+}
+
+void CodeGenerator::useMethodCache(const MethodCache& cache)
+{
+  m_method_cache = &cache;
+}
+
+void CodeGenerator::importInterfaces()
+{
+  // names in an interface file come from another compilation unit and must be
+  // identifiers, since pushScope("") would open an unnamed scope which
+  // destroys the entries created in it when it's popped
+  auto is_name = [](std::string_view name) {
+    if (name.empty() || (name[0] >= '0' && name[0] <= '9'))
+      return false;
+    return std::all_of(name.begin(), name.end(), [](unsigned char c) {
+      return std::isalnum(c) || c == '_' || c >= 0x80;
+    });
+  };
+
+  // calls function with the last part of path after entering the scope which
+  // path is in
+  auto in_scope_of = [this, &is_name](std::string_view path, auto function) {
+    if (path.size() < 2 || path[0] != '/')
+      throw make_error<InterfaceError>("invalid path in interface file: ",
+        path);
+    for (auto begin = std::size_t{1}; begin <= path.size();) {
+      auto end = std::min(path.find('/', begin), path.size());
+      if (!is_name(path.substr(begin, end - begin)))
+        throw make_error<InterfaceError>("invalid path in interface file: ",
+          path);
+      begin = end + 1;
+    }
+    std::size_t depth = 0;
+    auto begin = std::size_t{1};
+    for (auto end = path.find('/', begin); end != std::string_view::npos;
+      begin = end + 1, end = path.find('/', begin)) {
+      m_symbol_table.pushScope(path.substr(begin, end - begin));
+      ++depth;
+    }
+    function(path.substr(begin));
+    while (depth--)
+      m_symbol_table.popScope();
+  };
+
+  auto resolve_type = [this](std::string_view path) {
+    auto type = SymbolTable::sym_cast<SymbolTable::Type*>(
+      m_symbol_table.find(path));
+    if (!type)
+      throw make_error<InterfaceError>(
+        "interface file refers to unknown type '", path, '\'');
+    return type;
+  };
+
+  for (auto& interface_path : m_interface_paths) {
+    std::ifstream stream{interface_path, std::ios_base::binary};
+    if (!stream)
+      throw make_error<GeneralError>("unable to open interface file '",
+        interface_path, '\'');
+    auto interface = InterfaceFile::read(stream);
+
+    // Create all classes first since fields and methods may refer to any of
+    // them. Classes with fields get an opaque struct type whose body is set
+    // once the types of all fields are known.
+    std::vector<SymbolTable::Class*> classes;
+    for (auto& interface_class : interface.classes) {
+      in_scope_of(interface_class.path, [&](std::string_view name) {
+        classes.push_back(m_symbol_table.createClass(name));
+      });
+      if (!interface_class.fields.empty())
+        classes.back()->m_llvm_type = llvm::StructType::create(*m_context);
+      m_imported_classes.insert(classes.back());
+    }
+    for (std::size_t i = 0; i != classes.size(); ++i) {
+      auto sym_class = classes[i];
+      if (interface.classes[i].fields.empty())
+        continue;
+      std::vector<llvm::Type*> llvm_types;
+      for (auto& interface_field : interface.classes[i].fields) {
+        auto type = resolve_type(interface_field.type);
+        if (!is_name(interface_field.name))
+          throw make_error<InterfaceError>("invalid field name '",
+            interface_field.name, "' in interface file");
+        if (!type->m_llvm_type)
+          throw make_error<InterfaceError>("field '", interface_field.name,
+            "' in interface file has an empty type");
+        in_scope_of(concatenate(sym_class->path(), '/', interface_field.name),
+          [&](std::string_view name) {
+            sym_class->m_fields.push_back(m_symbol_table.createField(name,
+              type));
+        });
+        llvm_types.push_back(type->m_llvm_type);
+      }
+      llvm::cast<llvm::StructType>(sym_class->m_llvm_type)->setBody(
+        llvm_types);
+    }
+
+    // Methods are declared under the link names of the functions which
+    // implement them in the other compilation unit.
+    for (auto& interface_method : interface.methods) {
+      std::vector<SymbolTable::Type*> argument_types;
+      for (auto& argument_type : interface_method.argument_types)
+        argument_types.push_back(resolve_type(argument_type));
+      auto return_type = resolve_type(interface_method.return_type);
+      SymbolTable::Method* method = nullptr;
+      in_scope_of(interface_method.path, [&](std::string_view name) {
+        method = m_symbol_table.createMethod(name, std::move(argument_types),
+          return_type);
+      });
+      if (!SymbolTable::sym_cast<SymbolTable::Class*>(
+        m_symbol_table.find(method->parent())))
+        throw make_error<InterfaceError>("method '", interface_method.path,
+          "' in interface file is not in a class");
+      method->m_llvm_function = declareMethod(method,
+        interface_method.link_name);
+    }
+  }
+}
+
+namespace {
+
+// Collects every name a method uses: the names of the methods it calls
+// (operators included) and of the identifiers it refers to, which may be
+// variables, fields or classes.
+class NameCollector final : public ast::Visitor {
+public:
+
+  explicit NameCollector(std::set<std::string_view>& names)
+  : m_names{names}
+  {}
+
+  void visit(ast::Method* ast_method) override
+  {
+    for (auto& [name, type] : ast_method->arguments)
+      collect(type.get());
+    collect(ast_method->return_type.get());
+    collect(ast_method->statements);
+  }
+
+  void visit(ast::Declaration* ast_declaration) override
+  {
+    collect(ast_declaration->type.get());
+  }
+
+  void visit(ast::If* ast_if) override
+  {
+    collect(ast_if->condition.get());
+    collect(ast_if->if_body);
+    for (auto& [condition, body] : ast_if->elif_bodies) {
+      collect(condition.get());
+      collect(body);
+    }
+    collect(ast_if->else_body);
+  }
+
+  void visit(ast::InfiniteLoop* ast_loop) override
+  {
+    collect(ast_loop->body);
+  }
+
+  void visit(ast::PreTestLoop* ast_loop) override
+  {
+    collect(ast_loop->condition.get());
+    collect(ast_loop->body);
+    collect(ast_loop->else_body);
+  }
+
+  void visit(ast::Break*) override
+  {}
+
+  void visit(ast::Cycle*) override
+  {}
+
+  void visit(ast::Ret* ast_ret) override
+  {
+    collect(ast_ret->expression.get());
+  }
+
+  void visit(ast::ExpressionStatement* ast_statement) override
+  {
+    collect(ast_statement->expression.get());
+  }
+
+  void visit(ast::Assignment* ast_assignment) override
+  {
+    collect(ast_assignment->left.get());
+    collect(ast_assignment->right.get());
+  }
+
+  void visit(ast::Call* ast_call) override
+  {
+    collect(ast_call->expression.get());
+    m_names.insert(ast_call->name);
+    for (auto& argument : ast_call->arguments)
+      collect(argument.get());
+  }
+
+  void visit(ast::Identifier* ast_identifier) override
+  {
+    m_names.insert(ast_identifier->value);
+  }
+
+  void visit(ast::Real*) override
+  {}
+
+  void visit(ast::Integer*) override
+  {}
+
+  void visit(ast::Boolean*) override
+  {}
+
+  void visit(ast::String*) override
+  {}
+
+  void visit(ast::Character*) override
+  {}
+
+private:
+
+  std::set<std::string_view>& m_names;
+
+  void collect(ast::Node* ast_node)
+  {
+    if (ast_node)
+      ast::dispatch(ast_node, this);
+  }
+
+  void collect(std::vector<std::unique_ptr<ast::Statement>>& statements)
+  {
+    for (auto& ast_statement : statements)
+      collect(ast_statement.get());
+  }
+
+};
+
+}
+
+void CodeGenerator::indexReferences()
+{
+  for (auto& sym_class : m_symbol_table.classes())
+    m_classes_by_name.emplace(sym_class.name(), &sym_class);
+  for (auto& method : m_symbol_table.methods())
+    m_methods_by_name.emplace(method.name(), &method);
+}
+
+std::string CodeGenerator::describeReferences(ast::Method* ast_method)
+{
+  // Everything the code of a method may depend on besides its own body: the
+  // signatures of the methods it may call (and their decorators, since the
+  // attributes of a callee change the code of its callers) and the layouts of
+  // the classes whose values it may handle. Calls are only resolved while the
+  // code is generated, so every method and class with a name the method uses
+  // is included. Values can also reach the method without their class being
+  // named, so the classes of the current class, of the signatures of these
+  // methods and of the fields of all these classes are included as well.
+  std::set<std::string_view> names;
+  NameCollector name_collector{names};
+  ast::dispatch(ast_method, &name_collector);
+
+  std::map<std::string_view, SymbolTable::Method*> methods;
+  std::map<std::string_view, SymbolTable::Class*> classes;
+  std::vector<SymbolTable::Type*> types;
+  if (m_current_class)
+    types.push_back(m_current_class);
+  for (auto name : names) {
+    auto [classes_begin, classes_end] = m_classes_by_name.equal_range(name);
+    for (auto iter = classes_begin; iter != classes_end; ++iter)
+      types.push_back(iter->second);
+    auto [methods_begin, methods_end] = m_methods_by_name.equal_range(name);
+    for (auto iter = methods_begin; iter != methods_end; ++iter) {
+      auto method = iter->second;
+      methods.emplace(method->path(), method);
+      types.push_back(SymbolTable::sym_cast<SymbolTable::Type*>(
+        m_symbol_table.find(method->parent())));
+      types.insert(types.end(), method->m_argument_types.begin(),
+        method->m_argument_types.end());
+      types.push_back(method->m_return_type);
+    }
+  }
+  while (!types.empty()) {
+    auto sym_class = SymbolTable::sym_cast<SymbolTable::Class*>(types.back());
+    types.pop_back();
+    if (!sym_class || !classes.emplace(sym_class->path(), sym_class).second)
+      continue;
+    for (auto field : sym_class->m_fields)
+      types.push_back(field->m_type);
+  }
+
+  std::ostringstream stream;
+  for (auto [path, sym_class] : classes) {
+    stream << "class " << path;
+    for (auto field : sym_class->m_fields)
+      stream << ' ' << field->name() << ':' << field->m_type->path();
+    stream << '\n';
+  }
+  for (auto [path, method] : methods) {
+    stream << "method " << path;
+    for (auto argument_type : method->m_argument_types)
+      stream << ' ' << argument_type->path();
+    stream << " : " << method->m_return_type->path();
+    for (auto& decorator : method->m_decorators)
+      stream << " @" << decorator;
+    if (method->m_llvm_function)
+      stream << ' ' << method->m_llvm_function->getName().str();
+    stream << '\n';
+  }
+  return stream.str();
+}
+
+void CodeGenerator::exportInterface(std::string path)
+{
+  InterfaceFile interface;
+  for (auto& sym_class : m_symbol_table.classes()) {
+    if (m_imported_classes.count(&sym_class))
+      continue;
+    auto& interface_class = interface.classes.emplace_back();
+    interface_class.path = std::string(sym_class.path());
+    for (auto field : sym_class.m_fields)
+      interface_class.fields.push_back({std::string(field->name()),
+        std::string(field->m_type->path())});
+  }
+  for (auto& method : m_symbol_table.methods()) {
+    // skip built-in methods and the methods of imported classes
+    auto method_class = SymbolTable::sym_cast<SymbolTable::Class*>(
+      m_symbol_table.find(method.parent()));
+    if (!method_class || m_imported_classes.count(method_class))
+      continue;
+    auto& interface_method = interface.methods.emplace_back();
+    interface_method.path = std::string(method.path());
+    interface_method.link_name = method.m_llvm_function->getName().str();
+    for (auto argument_type : method.m_argument_types)
+      interface_method.argument_types.emplace_back(argument_type->path());
+    interface_method.return_type = std::string(method.m_return_type->path());
+  }
+  std::ofstream stream;
+  stream.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+  stream.open(path, std::ios_base::binary);
+  interface.write(stream);
+}
+
 namespace {
 
 class InitializeClassesPass : public ast::Visitor {
@@ -255,8 +1264,9 @@ void InitializeFieldsAndMethodsPass::visit(ast::Method* ast_method)
       return m_symbol_table.resolveType(argument.second.get());
   });
   auto return_type = m_symbol_table.resolveType(ast_method->return_type.get());
-  m_symbol_table.createMethod(ast_method->name, std::move(argument_types),
-  return_type);
+  auto method = m_symbol_table.createMethod(ast_method->name,
+    std::move(argument_types), return_type);
+  method->m_decorators = ast_method->decorators;
 }
 
 void InitializeFieldsAndMethodsPass::visit(ast::Field* ast_field)
@@ -280,16 +1290,14 @@ void CodeGenerator::resolveClasses()
   using BiMap = boost::bimap<SymbolTable::Class*, Graph::vertex_descriptor>;
   Graph graph;
   BiMap table;
-  for (auto entry : m_symbol_table)
-    if (auto sym_class = SymbolTable::sym_cast<SymbolTable::Class*>(entry))
-      table.insert(BiMap::value_type(sym_class, boost::add_vertex(graph)));
-  for (auto entry : m_symbol_table)
-    if (auto field = SymbolTable::sym_cast<SymbolTable::Field*>(entry))
-      if (auto field_class = SymbolTable::sym_cast<SymbolTable::Class*>(
-        field->m_type))
-        boost::add_edge(table.left.find(
-          m_symbol_table.gotoPath<SymbolTable::Class*>(field->parent()))->second,
-              table.left.find(field_class)->second, graph);
+  for (auto& sym_class : m_symbol_table.classes())
+    table.insert(BiMap::value_type(&sym_class, boost::add_vertex(graph)));
+  for (auto& field : m_symbol_table.fields())
+    if (auto field_class = SymbolTable::sym_cast<SymbolTable::Class*>(
+      field.m_type))
+      boost::add_edge(table.left.find(
+        m_symbol_table.gotoPath<SymbolTable::Class*>(field.parent()))->second,
+            table.left.find(field_class)->second, graph);
   std::vector<Graph::vertex_descriptor> result;
   try {
     boost::topological_sort(graph, std::back_inserter(result));
@@ -298,6 +1306,8 @@ void CodeGenerator::resolveClasses()
   }
   for (auto iter : result) {
     auto sym_class = table.right.find(iter)->second;
+    if (m_imported_classes.count(sym_class))
+      continue;
     if (sym_class->m_fields.size()) {
       std::vector<llvm::Type*> llvm_types{sym_class->m_fields.size()};
       BUCKET_ASSERT(std::all_of(sym_class->m_fields.begin(),
@@ -307,76 +1317,288 @@ void CodeGenerator::resolveClasses()
           return field->m_type->m_llvm_type;});
       BUCKET_ASSERT(std::all_of(llvm_types.begin(), llvm_types.end(),
         [](bool b){return b;}));
-      sym_class->m_llvm_type = llvm::StructType::create(m_context, llvm_types);
+      sym_class->m_llvm_type = llvm::StructType::create(*m_context, llvm_types);
     }
   }
 }
 
 void CodeGenerator::resolveMethods()
 {
-  // we have to be careful to avoid iterator invalidation here
-  std::vector<SymbolTable::Entry*> symbol_table_entries{m_symbol_table.begin(),
-    m_symbol_table.end()};
-  for (auto entry_ptr : symbol_table_entries) {
-    if (auto method_ptr = SymbolTable::sym_cast<SymbolTable::Method*>(entry_ptr)
-        ) {
-      if (!method_ptr->m_llvm_function) {
-        auto method_type = m_symbol_table.gotoPath<SymbolTable::Class*>(method_ptr->parent());
-        std::vector<llvm::Type*> argument_types;
-        if (method_type->m_llvm_type) {
-          // non empty type
-          argument_types.resize(method_ptr->m_argument_types.size() + 1);
-          argument_types[0] = m_symbol_table.getPointerType(method_type)->m_llvm_type;
-          std::transform(method_ptr->m_argument_types.begin(),
-            method_ptr->m_argument_types.end(), argument_types.begin() + 1,
-            [](SymbolTable::Type* type){return type->m_llvm_type;});
-        }
-        else {
-          // empty type
-          argument_types.resize(method_ptr->m_argument_types.size());
-          std::transform(method_ptr->m_argument_types.begin(),
-            method_ptr->m_argument_types.end(), argument_types.begin(),
-            [](SymbolTable::Type* type){return type->m_llvm_type;});
-        }
-        auto function_type = llvm::FunctionType::get(
-          method_ptr->m_return_type->m_llvm_type, argument_types, false);
-        method_ptr->m_llvm_function = llvm::Function::Create(function_type,
-          llvm::Function::ExternalLinkage, llvm::StringRef(
-            method_ptr->path().data(), method_ptr->path().size()),
-              m_module);
-      }
+  // getPointerType() may create new types while we iterate, but that only
+  // touches the type index, not the method index.
+  for (auto& method : m_symbol_table.methods()) {
+    auto method_ptr = &method;
+    if (!method_ptr->m_llvm_function) {
+      method_ptr->m_llvm_function = declareMethod(method_ptr,
+        method_ptr->path());
+      applyDecorators(method_ptr);
     }
   }
 }
 
-void CodeGenerator::finalize()
+void CodeGenerator::applyDecorators(SymbolTable::Method* method_ptr)
+{
+  // The attributes are promises the optimizer relies on without checking
+  // them, just like the corresponding attributes of C compilers. Nothing is
+  // inlined at O0, so @inline has no effect there.
+  auto function = method_ptr->m_llvm_function;
+  // llvm 13 started putting the '.' between a section and its prefix itself
+  #if LLVM_VERSION_MAJOR >= 13
+  const char* hot_prefix = "hot";
+  const char* unlikely_prefix = "unlikely";
+  #else
+  const char* hot_prefix = ".hot";
+  const char* unlikely_prefix = ".unlikely";
+  #endif
+  for (auto decorator : method_ptr->m_decorators) {
+    auto name = decorator.view();
+    if (name == "inline") {
+      function->addFnAttr(llvm::Attribute::AlwaysInline);
+    }
+    else if (name == "noinline") {
+      function->addFnAttr(llvm::Attribute::NoInline);
+    }
+    else if (name == "hot") {
+      // llvm 11 has no hot attribute, but the code generator also puts
+      // functions with this prefix into .text.hot
+      #if LLVM_VERSION_MAJOR >= 12
+      function->addFnAttr(llvm::Attribute::Hot);
+      #endif
+      function->setSectionPrefix(hot_prefix);
+    }
+    else if (name == "cold") {
+      // calls to cold functions are assumed to be unlikely, which moves the
+      // paths leading to them out of the way
+      function->addFnAttr(llvm::Attribute::Cold);
+      function->setSectionPrefix(unlikely_prefix);
+    }
+    else if (name == "pure") {
+      // a pure method doesn't write to memory and always returns, so calls to
+      // it whose results aren't used can be dropped and repeated calls with
+      // the same arguments merged
+      function->addFnAttr(llvm::Attribute::ReadOnly);
+      function->addFnAttr(llvm::Attribute::NoUnwind);
+      function->addFnAttr(llvm::Attribute::WillReturn);
+    }
+    else if (name == "leaf") {
+      // a leaf method doesn't call back into the program
+      function->addFnAttr(llvm::Attribute::NoRecurse);
+      #if LLVM_VERSION_MAJOR >= 16
+      function->addFnAttr(llvm::Attribute::NoCallback);
+      #endif
+    }
+    else {
+      BUCKET_UNREACHABLE();
+    }
+  }
+}
+
+llvm::Function* CodeGenerator::declareMethod(SymbolTable::Method* method_ptr,
+  std::string_view link_name)
+{
+  auto method_type = m_symbol_table.gotoPath<SymbolTable::Type*>(method_ptr->parent());
+  std::vector<llvm::Type*> argument_types;
+  if (method_type->m_llvm_type) {
+    // non empty type, classes are passed by pointer and primitives by value
+    argument_types.resize(method_ptr->m_argument_types.size() + 1);
+    argument_types[0] = passedByPointer(method_type)
+      ? m_symbol_table.getPointerType(method_type)->m_llvm_type
+      : method_type->m_llvm_type;
+    std::transform(method_ptr->m_argument_types.begin(),
+      method_ptr->m_argument_types.end(), argument_types.begin() + 1,
+      [](SymbolTable::Type* type){return type->m_llvm_type;});
+  }
+  else {
+    // empty type
+    argument_types.resize(method_ptr->m_argument_types.size());
+    std::transform(method_ptr->m_argument_types.begin(),
+      method_ptr->m_argument_types.end(), argument_types.begin(),
+      [](SymbolTable::Type* type){return type->m_llvm_type;});
+  }
+  auto function_type = llvm::FunctionType::get(
+    method_ptr->m_return_type->m_llvm_type, argument_types, false);
+  return llvm::Function::Create(function_type, llvm::Function::ExternalLinkage,
+    llvm::StringRef(link_name.data(), link_name.size()), *m_module);
+}
+
+SymbolTable::Variable* CodeGenerator::createVariable(std::string_view name,
+  SymbolTable::Type* type)
+{
+  auto variable = m_method_symbol_table->createVariable(name, type);
+  // the symbol table reuses the storage of variables which went out of scope,
+  // so forget any definitions left over from a previous variable
+  m_definitions.erase(variable);
+  return variable;
+}
+
+void CodeGenerator::writeVariable(SymbolTable::Variable* variable,
+  llvm::BasicBlock* block, llvm::Value* value)
+{
+  m_definitions[variable][block] = value;
+}
+
+llvm::Value* CodeGenerator::readVariable(SymbolTable::Variable* variable,
+  llvm::BasicBlock* block)
+{
+  auto& definitions = m_definitions[variable];
+  if (auto iter = definitions.find(block);
+    iter != definitions.end() && iter->second)
+    return iter->second;
+  return readVariableRecursive(variable, block);
+}
+
+llvm::Value* CodeGenerator::readVariableRecursive(
+  SymbolTable::Variable* variable, llvm::BasicBlock* block)
+{
+  auto llvm_type = variable->m_type->m_llvm_type;
+  auto createPhi = [&]{
+    auto name = llvm::StringRef(variable->path().data(),
+      variable->path().size());
+    return block->empty()
+      ? llvm::PHINode::Create(llvm_type, 0, name, block)
+      : llvm::PHINode::Create(llvm_type, 0, name, &block->front());
+  };
+  llvm::Value* value;
+  if (!m_sealed_blocks.count(block)) {
+    // not all predecessors are known yet, the operands are added when the block
+    // is sealed
+    auto phi = createPhi();
+    m_incomplete_phis[block].emplace_back(variable, phi);
+    value = phi;
+  }
+  else if (llvm::pred_empty(block)) {
+    // the variable is read in unreachable code (or before it is assigned)
+    value = llvm::UndefValue::get(llvm_type);
+  }
+  else if (auto predecessor = block->getSinglePredecessor()) {
+    // no phi needed
+    value = readVariable(variable, predecessor);
+  }
+  else {
+    // break potential cycles by recording the phi before looking at the
+    // predecessors
+    auto phi = createPhi();
+    writeVariable(variable, block, phi);
+    value = addPhiOperands(variable, phi);
+  }
+  writeVariable(variable, block, value);
+  return value;
+}
+
+llvm::Value* CodeGenerator::addPhiOperands(SymbolTable::Variable* variable,
+  llvm::PHINode* phi)
+{
+  for (auto predecessor : llvm::predecessors(phi->getParent()))
+    phi->addIncoming(readVariable(variable, predecessor), predecessor);
+  return tryRemoveTrivialPhi(phi);
+}
+
+llvm::Value* CodeGenerator::tryRemoveTrivialPhi(llvm::PHINode* phi)
+{
+  // a phi is trivial if it merges a single value other than itself
+  llvm::Value* same = nullptr;
+  for (auto& operand : phi->incoming_values()) {
+    if (operand == same || operand == phi)
+      continue;
+    if (same)
+      return phi;
+    same = operand;
+  }
+  if (!same)
+    same = llvm::UndefValue::get(phi->getType());
+
+  // removing the phi may make phis using it trivial as well
+  llvm::SmallVector<llvm::WeakVH, 8> users;
+  for (auto user : phi->users())
+    if (user != phi)
+      users.emplace_back(user);
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
+  for (auto& user : users)
+    if (auto user_phi = llvm::dyn_cast_or_null<llvm::PHINode>(user))
+      tryRemoveTrivialPhi(user_phi);
+  return same;
+}
+
+void CodeGenerator::sealBlock(llvm::BasicBlock* block)
+{
+  BUCKET_ASSERT(!m_sealed_blocks.count(block));
+  if (auto iter = m_incomplete_phis.find(block);
+    iter != m_incomplete_phis.end()) {
+    auto incomplete_phis = std::move(iter->second);
+    m_incomplete_phis.erase(iter);
+    for (auto [variable, phi] : incomplete_phis)
+      addPhiOperands(variable, phi);
+  }
+  m_sealed_blocks.insert(block);
+}
+
+llvm::AllocaInst* CodeGenerator::acquireSlot(llvm::Type* type)
+{
+  llvm::AllocaInst* slot;
+  auto& free_slots = m_free_slots[type];
+  if (free_slots.empty()) {
+    auto old_insertion_point = m_ir_builder.saveIP();
+    m_ir_builder.SetInsertPoint(m_entry_block, m_entry_block->begin());
+    slot = m_ir_builder.CreateAlloca(type, 0, nullptr, "temp");
+    m_ir_builder.restoreIP(old_insertion_point);
+  }
+  else {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  }
+  m_ir_builder.CreateLifetimeStart(slot);
+  return slot;
+}
+
+void CodeGenerator::releaseSlot(llvm::AllocaInst* slot)
+{
+  m_ir_builder.CreateLifetimeEnd(slot);
+  m_free_slots[slot->getAllocatedType()].push_back(slot);
+}
+
+void CodeGenerator::createEntryPoint(SymbolTable::Method* module_main)
 {
   auto actual_main = llvm::Function::Create(
     llvm::FunctionType::get(m_ir_builder.getInt32Ty(), {m_ir_builder.getInt32Ty(),
       m_ir_builder.getInt8Ty()->getPointerTo()->getPointerTo()}, false),
-      llvm::Function::ExternalLinkage, "main", &m_module
+      llvm::Function::ExternalLinkage, "main", m_module.get()
   );
-  auto module_main = m_symbol_table.gotoPath<SymbolTable::Method*>("/main/main");
   BUCKET_ASSERT(module_main->m_return_type ==
     m_symbol_table.gotoPath<SymbolTable::Type*>("/bool"));
   BUCKET_ASSERT(module_main->m_argument_types.size() == 0);
-  m_ir_builder.SetInsertPoint(llvm::BasicBlock::Create(m_context,
+  m_ir_builder.SetInsertPoint(llvm::BasicBlock::Create(*m_context,
       "$entry", actual_main));
   auto call_inst = m_ir_builder.CreateCall(module_main->m_llvm_function);
-  auto then_bb = llvm::BasicBlock::Create(m_context, "$then", actual_main);
-  auto else_bb = llvm::BasicBlock::Create(m_context, "$else", actual_main);
+  auto then_bb = llvm::BasicBlock::Create(*m_context, "$then", actual_main);
+  auto else_bb = llvm::BasicBlock::Create(*m_context, "$else", actual_main);
   m_ir_builder.CreateCondBr(call_inst, then_bb, else_bb);
   m_ir_builder.SetInsertPoint(then_bb);
   m_ir_builder.CreateRet(llvm::ConstantInt::getSigned(
-    llvm::Type::getInt32Ty(m_context), 0));
+    llvm::Type::getInt32Ty(*m_context), 0));
   m_ir_builder.SetInsertPoint(else_bb);
   m_ir_builder.CreateRet(llvm::ConstantInt::getSigned(
-    llvm::Type::getInt32Ty(m_context), 1));
+    llvm::Type::getInt32Ty(*m_context), 1));
+}
+
+void CodeGenerator::finalize()
+{
+  // only the compilation unit which defines main gets an entry point (in its
+  // first shard)
+  auto module_main = SymbolTable::sym_cast<SymbolTable::Method*>(
+    m_symbol_table.find("/main/main"));
+  if (m_shard == 0 && module_main && !m_imported_classes.count(
+    m_symbol_table.gotoPath<SymbolTable::Class*>("/main")))
+    createEntryPoint(module_main);
+
+  for (auto& function : *m_module)
+    if (!function.isDeclaration())
+      setTargetAttributes(function, m_target);
 
   // Verify the function
   std::string error_message;
   llvm::raw_string_ostream stream{error_message};
-  if (llvm::verifyModule(m_module, &stream)) {
+  if (llvm::verifyModule(*m_module, &stream)) {
     #ifdef BUCKET_DEBUG
     throw make_error<CodeGeneratorError>("failed to verify llvm module:\n",
       stream.str()
@@ -390,56 +1612,91 @@ void CodeGenerator::finalize()
 void CodeGenerator::visit(ast::Program* ast_program)
 {
   initializeBuiltins();
+  importInterfaces();
   initializeClasses(ast_program);
   initializeFieldsAndMethods(ast_program);
   resolveClasses();
   resolveMethods();
+  m_symbol_table.freeze();
+  if (m_method_cache)
+    indexReferences();
   for (auto& ast_global : ast_program->globals)
     ast::dispatch(ast_global.get(), this);
   finalize();
 }
 
+std::string CodeGenerator::classScope() const
+{
+  // The frozen symbol table's scope can't change, so the scope of the class
+  // being visited is derived from the class instead (for the lookups of its
+  // globals and the overlays of its methods).
+  if (!m_current_class)
+    return "/";
+  return std::string(m_current_class->path()) + '/';
+}
+
 void CodeGenerator::visit(ast::Class* ast_class)
 {
   // update the current class variable
   auto old_class = m_current_class;
-  m_current_class = m_symbol_table.gotoName<SymbolTable::Class*>(
-    ast_class->name
+  m_current_class = m_symbol_table.gotoPath<SymbolTable::Class*>(
+    classScope() + std::string(ast_class->name)
   );
 
-  // enter the scope of the class
-  m_symbol_table.pushScope(ast_class->name);
-
   // visit everything in the class
   for (auto& ast_global : ast_class->globals)
     ast::dispatch(ast_global.get(), this);
 
-  // exit the scope of the class
-  m_symbol_table.popScope();
-
   // reset the current class variable to its previous value
   m_current_class = old_class;
 }
 
 void CodeGenerator::visit(ast::Method* ast_method)
 {
+  // methods belonging to other shards are only declared in this one
+  if (m_method_count++ % m_shard_count != m_shard)
+    return;
+
   // set the current method
-  m_current_method = m_symbol_table.gotoName<SymbolTable::Method*>(
-    ast_method->name
+  m_current_method = m_symbol_table.gotoPath<SymbolTable::Method*>(
+    classScope() + std::string(ast_method->name)
   );
+
+  // methods whose code is in the cache are only declared
+  if (m_method_cache) {
+    auto key = m_method_cache->key(m_current_method->path(), *ast_method,
+      describeReferences(ast_method));
+    bool cached = m_method_cache->contains(key);
+    m_method_keys.emplace(m_current_method->m_llvm_function->getName().str(),
+      std::move(key));
+    if (cached)
+      return;
+  }
   m_after_jump = false;
 
-  // enter an anonymous scope
-  m_symbol_table.pushScope();
+  // the body of the method gets its own symbol table on top of the frozen
+  // global one
+  m_method_symbol_table.emplace(&m_symbol_table, classScope());
 
-  // Create entry block and set IR builder to insert there
-  m_scope_entry_block = llvm::BasicBlock::Create(
-    m_context, "$entry", m_current_method->m_llvm_function
+  // enter an anonymous scope
+  m_method_symbol_table->pushScope();
+
+  // start SSA construction from scratch
+  m_definitions.clear();
+  m_incomplete_phis.clear();
+  m_sealed_blocks.clear();
+  m_free_slots.clear();
+
+  // Create entry block and set IR builder to insert there. The entry block has
+  // no predecessors so it is sealed right away.
+  m_entry_block = llvm::BasicBlock::Create(
+    *m_context, "$entry", m_current_method->m_llvm_function
   );
-  m_ir_builder.SetInsertPoint(m_scope_entry_block);
+  m_ir_builder.SetInsertPoint(m_entry_block);
+  sealBlock(m_entry_block);
 
-  // Define variables corresponding to the function arguments in both the symbol
-  // table and the llvm function and generate store instructions.
+  // Define variables corresponding to the function arguments in the symbol
+  // table and make the llvm arguments their initial definitions.
   {
     auto llvm_arg_iter = m_current_method->m_llvm_function->arg_begin();
     auto llvm_arg_end = m_current_method->m_llvm_function->arg_end();
@@ -451,14 +1708,12 @@ void CodeGenerator::visit(ast::Method* ast_method)
     // If the method is defined on a non empty class, it takes pointer to that
     // class as a first argument which it assigns to the variable 'this'.
     if (m_current_class->m_fields.size() > 0) {
-      auto this_variable = m_symbol_table.createVariable(
-        "this", m_symbol_table.getPointerType(m_current_class)
+      auto this_variable = createVariable(
+        "this", m_method_symbol_table->getPointerType(m_current_class)
       );
-      this_variable->m_llvm_value = m_ir_builder.CreateAlloca(
-        this_variable->m_type->m_llvm_type, 0, nullptr, llvm::StringRef(
-          this_variable->path().data(), this_variable->path().size()
-      ));
-      m_ir_builder.CreateStore(llvm_arg_iter, this_variable->m_llvm_value);
+      llvm_arg_iter->setName(llvm::StringRef(
+        this_variable->path().data(), this_variable->path().size()));
+      writeVariable(this_variable, m_entry_block, llvm_arg_iter);
       ++llvm_arg_iter;
     }
 
@@ -466,14 +1721,10 @@ void CodeGenerator::visit(ast::Method* ast_method)
     while (llvm_arg_iter != llvm_arg_end) {
       BUCKET_ASSERT(ast_arg_iter != ast_arg_end);
       BUCKET_ASSERT(sym_arg_iter != sym_arg_end);
-      auto arg_variable = m_symbol_table.createVariable(
-        ast_arg_iter->first, *sym_arg_iter
-      );
-      arg_variable->m_llvm_value = m_ir_builder.CreateAlloca(
-        arg_variable->m_type->m_llvm_type, 0, nullptr, llvm::StringRef(
-          arg_variable->path().data(), arg_variable->path().size()
-      ));
-      m_ir_builder.CreateStore(llvm_arg_iter, arg_variable->m_llvm_value);
+      auto arg_variable = createVariable(ast_arg_iter->first, *sym_arg_iter);
+      llvm_arg_iter->setName(llvm::StringRef(
+        arg_variable->path().data(), arg_variable->path().size()));
+      writeVariable(arg_variable, m_entry_block, llvm_arg_iter);
       ++llvm_arg_iter;
       ++ast_arg_iter;
       ++sym_arg_iter;
@@ -487,7 +1738,7 @@ void CodeGenerator::visit(ast::Method* ast_method)
   // Check that the function has returned
   if (!m_after_jump) {
     if (m_current_method->m_return_type !=
-        m_symbol_table.gotoPath<SymbolTable::Type*>("/nil")) {
+        m_method_symbol_table->gotoPath<SymbolTable::Type*>("/nil")) {
       throw make_error<CodeGeneratorError>(
         "method '", m_current_method->name(), "' in class '",
         m_current_class->path(), "' reaches end of code without returning"
@@ -504,7 +1755,7 @@ void CodeGenerator::visit(ast::Method* ast_method)
     std::string name{"-"};
     std::error_code error_code;
     llvm::raw_fd_ostream ostream{llvm::StringRef(name.data(), name.size()), error_code};
-    m_module.print(ostream, nullptr);
+    m_module->print(ostream, nullptr);
     if (error_code)
       throw make_error<CodeGeneratorError>("unable to print IR to file: ", error_code.message());
     throw make_error<CodeGeneratorError>("failed to verify llvm function:\n",
@@ -516,7 +1767,8 @@ void CodeGenerator::visit(ast::Method* ast_method)
   }
 
   // exit the scope
-  m_symbol_table.popScope();
+  m_method_symbol_table->popScope();
+  m_method_symbol_table.reset();
 }
 
 void CodeGenerator::visit(ast::Field*)
@@ -527,18 +1779,12 @@ void CodeGenerator::visit(ast::Declaration* ast_declaration)
   if (m_after_jump)
     throw make_error<CodeGeneratorError>("code appears after return, break, or "
       "cycle");
-  auto variable = m_symbol_table.createVariable(
-    ast_declaration->name, m_symbol_table.resolveType(ast_declaration->type.get())
-  );
-  auto old_insertion_point = m_ir_builder.saveIP();
-  m_ir_builder.SetInsertPoint(m_scope_entry_block,
-    m_scope_entry_block->begin()
+  auto variable = createVariable(
+    ast_declaration->name, m_method_symbol_table->resolveType(ast_declaration->type.get())
   );
-  variable->m_llvm_value = m_ir_builder.CreateAlloca(
-    variable->m_type->m_llvm_type, 0, nullptr, llvm::StringRef(
-      variable->path().data(), variable->path().size()
-  ));
-  m_ir_builder.restoreIP(old_insertion_point);
+  // a declared variable is undefined until it is assigned
+  writeVariable(variable, m_ir_builder.GetInsertBlock(),
+    llvm::UndefValue::get(variable->m_type->m_llvm_type));
 }
 
 void CodeGenerator::visit(ast::If* ast_if)
@@ -548,13 +1794,10 @@ void CodeGenerator::visit(ast::If* ast_if)
       "cycle");
 
   //
-  auto merge_block = llvm::BasicBlock::Create(m_context, "$if_merge",
+  auto merge_block = llvm::BasicBlock::Create(*m_context, "$if_merge",
     m_current_method->m_llvm_function
   );
 
-  // Save the old scope entry block
-  auto old_scope_entry_block = m_scope_entry_block;
-
   // define a function that generates code for a single conditional (i.e. for a
   // single if or elif)
   auto generateCodeForConditional = [this, merge_block](
@@ -571,31 +1814,31 @@ void CodeGenerator::visit(ast::If* ast_if)
         " runtime value");
 
     // ensure condition expression is a boolean
-    if (m_expression_type != m_symbol_table.gotoPath<SymbolTable::Type*>("/bool"))
+    if (m_expression_type != m_method_symbol_table->gotoPath<SymbolTable::Type*>("/bool"))
       throw make_error<CodeGeneratorError>("condition in if statement must be a "
         "boolean, not an expression of type '",
         m_expression_type->path(), '\'');
 
     // Create labels for when the condition is true and false
-    llvm::BasicBlock* then_block = llvm::BasicBlock::Create(m_context,
+    llvm::BasicBlock* then_block = llvm::BasicBlock::Create(*m_context,
       "$if_then", m_current_method->m_llvm_function
     );
-    llvm::BasicBlock* else_block = llvm::BasicBlock::Create(m_context,
+    llvm::BasicBlock* else_block = llvm::BasicBlock::Create(*m_context,
       "$if_else", m_current_method->m_llvm_function
     );
 
     // Create a branch instruction
     m_ir_builder.CreateCondBr(m_expression_value, then_block, else_block);
-
-    m_scope_entry_block = then_block;
+    sealBlock(then_block);
+    sealBlock(else_block);
 
     // Start generating code for the conditional body
     m_ir_builder.SetInsertPoint(then_block);
 
-    m_symbol_table.pushScope();
+    m_method_symbol_table->pushScope();
     for (auto& ast_statement : ast_body)
       ast::dispatch(ast_statement.get(), this);
-    m_symbol_table.popScope();
+    m_method_symbol_table->popScope();
 
     if (!m_after_jump)
       m_ir_builder.CreateBr(merge_block);
@@ -603,7 +1846,6 @@ void CodeGenerator::visit(ast::If* ast_if)
 
     // Set the insert point to the else block
     m_ir_builder.SetInsertPoint(else_block);
-    m_scope_entry_block = else_block;
   };
 
   // Generate code for the main conditional and the elifs
@@ -612,17 +1854,17 @@ void CodeGenerator::visit(ast::If* ast_if)
     generateCodeForConditional(elif.first, elif.second);
 
   // generate code for the else body
-  m_symbol_table.pushScope();
+  m_method_symbol_table->pushScope();
   for (auto& ast_statement : ast_if->else_body)
     ast::dispatch(ast_statement.get(), this);
-  m_symbol_table.popScope();
+  m_method_symbol_table->popScope();
   if (!m_after_jump)
     m_ir_builder.CreateBr(merge_block);
   m_after_jump = false;
 
-  // Set the insert point to after the merge block and reset scope entry block
+  // Set the insert point to after the merge block
+  sealBlock(merge_block);
   m_ir_builder.SetInsertPoint(merge_block);
-  m_scope_entry_block = old_scope_entry_block;
 }
 
 void CodeGenerator::visit(ast::InfiniteLoop* ast_infinite_loop)
@@ -633,29 +1875,32 @@ void CodeGenerator::visit(ast::InfiniteLoop* ast_infinite_loop)
 
   auto old_loop_entry_block = m_loop_entry_block;
   auto old_loop_merge_block = m_loop_merge_block;
-  auto old_scope_entry_block = m_scope_entry_block;
+  auto old_loop_id = m_loop_id;
 
-  m_loop_entry_block = llvm::BasicBlock::Create(m_context, "$loop_entry",
+  m_loop_id = createLoopId(ast_infinite_loop->annotations);
+  m_loop_entry_block = llvm::BasicBlock::Create(*m_context, "$loop_entry",
     m_current_method->m_llvm_function
   );
-  m_loop_merge_block = llvm::BasicBlock::Create(m_context, "$loop_merge",
+  m_loop_merge_block = llvm::BasicBlock::Create(*m_context, "$loop_merge",
     m_current_method->m_llvm_function
   );
-  m_scope_entry_block = m_loop_entry_block;
 
   m_ir_builder.CreateBr(m_loop_entry_block);
   m_ir_builder.SetInsertPoint(m_loop_entry_block);
-  m_symbol_table.pushScope();
+  m_method_symbol_table->pushScope();
   for (auto& ast_statement : ast_infinite_loop->body)
     ast::dispatch(ast_statement.get(), this);
-  m_symbol_table.popScope();
+  m_method_symbol_table->popScope();
   if (!m_after_jump)
-    m_ir_builder.CreateBr(m_loop_entry_block);
+    createBackEdge();
   m_after_jump = false;
+  // every jump to the loop entry and merge blocks has been emitted
+  sealBlock(m_loop_entry_block);
+  sealBlock(m_loop_merge_block);
   m_ir_builder.SetInsertPoint(m_loop_merge_block);
   m_loop_merge_block = old_loop_merge_block;
   m_loop_entry_block = old_loop_entry_block;
-  m_scope_entry_block = old_scope_entry_block;
+  m_loop_id = old_loop_id;
 }
 
 void CodeGenerator::visit(ast::PreTestLoop* ast_pre_test_loop) {
@@ -665,19 +1910,19 @@ void CodeGenerator::visit(ast::PreTestLoop* ast_pre_test_loop) {
 
   auto old_loop_entry_block = m_loop_entry_block;
   auto old_loop_merge_block = m_loop_merge_block;
-  auto old_scope_entry_block = m_scope_entry_block;
+  auto old_loop_id = m_loop_id;
 
-  m_loop_entry_block = llvm::BasicBlock::Create(m_context, "$loop_entry",
+  m_loop_id = createLoopId(ast_pre_test_loop->annotations);
+  m_loop_entry_block = llvm::BasicBlock::Create(*m_context, "$loop_entry",
     m_current_method->m_llvm_function
   );
-  m_loop_merge_block = llvm::BasicBlock::Create(m_context, "$merge",
+  m_loop_merge_block = llvm::BasicBlock::Create(*m_context, "$merge",
     m_current_method->m_llvm_function
   );
-  m_scope_entry_block = m_loop_entry_block;
 
   m_ir_builder.CreateBr(m_loop_entry_block);
   m_ir_builder.SetInsertPoint(m_loop_entry_block);
-  m_symbol_table.pushScope();
+  m_method_symbol_table->pushScope();
 
   ast::dispatch(ast_pre_test_loop->condition.get(), this);
 
@@ -688,46 +1933,50 @@ void CodeGenerator::visit(ast::PreTestLoop* ast_pre_test_loop) {
     );
 
   // ensure condition expression is a boolean
-  if (m_expression_type != m_symbol_table.gotoPath<SymbolTable::Type*>("/bool"))
+  if (m_expression_type != m_method_symbol_table->gotoPath<SymbolTable::Type*>("/bool"))
     throw make_error<CodeGeneratorError>("condition in loop must be a boolean, n"
       "ot an expression of type '", m_expression_type->path(), '\''
     );
 
   auto loop_condition_true_block = llvm::BasicBlock::Create(
-    m_context, "$loop_condition_true", m_current_method->m_llvm_function
+    *m_context, "$loop_condition_true", m_current_method->m_llvm_function
   );
 
-  auto loop_else_block = llvm::BasicBlock::Create(m_context, "$loop_else",
+  auto loop_else_block = llvm::BasicBlock::Create(*m_context, "$loop_else",
     m_current_method->m_llvm_function
   );
 
   m_ir_builder.CreateCondBr(m_expression_value, loop_condition_true_block,
     loop_else_block
   );
+  sealBlock(loop_condition_true_block);
+  sealBlock(loop_else_block);
 
   m_ir_builder.SetInsertPoint(loop_condition_true_block);
   for (auto& ast_statement : ast_pre_test_loop->body)
     ast::dispatch(ast_statement.get(), this);
   if (!m_after_jump)
-    m_ir_builder.CreateBr(m_loop_entry_block);
+    createBackEdge();
+  // every jump to the loop entry block has been emitted
+  sealBlock(m_loop_entry_block);
 
   m_after_jump = false;
-  m_symbol_table.popScope();
-  m_symbol_table.pushScope();
+  m_method_symbol_table->popScope();
+  m_method_symbol_table->pushScope();
   auto pre_test_loop_merge_block = m_loop_merge_block; // so break statements in
     //the else work
   m_loop_merge_block = old_loop_merge_block;
   m_loop_entry_block = old_loop_entry_block;
-  m_scope_entry_block = loop_else_block;
+  m_loop_id = old_loop_id;
   m_ir_builder.SetInsertPoint(loop_else_block);
   for (auto& ast_statement : ast_pre_test_loop->else_body)
     ast::dispatch(ast_statement.get(), this);
   if (!m_after_jump)
     m_ir_builder.CreateBr(pre_test_loop_merge_block);
-  m_symbol_table.popScope();
+  m_method_symbol_table->popScope();
   m_after_jump = false;
+  sealBlock(pre_test_loop_merge_block);
   m_ir_builder.SetInsertPoint(pre_test_loop_merge_block);
-  m_scope_entry_block = old_scope_entry_block;
 }
 
 void CodeGenerator::visit(ast::Break*)
@@ -754,7 +2003,7 @@ void CodeGenerator::visit(ast::Cycle*)
     throw make_error<CodeGeneratorError>("break statement occurs outside of a l"
       "oop"
   );
-  m_ir_builder.CreateBr(m_loop_entry_block);
+  createBackEdge();
   m_after_jump = true;
 }
 
@@ -763,16 +2012,58 @@ void CodeGenerator::visit(ast::Ret* ast_ret)
   if (m_after_jump)
     throw make_error<CodeGeneratorError>("code appears after return, break, or "
       "cycle");
+  auto nil_type = m_method_symbol_table->gotoPath<SymbolTable::Type*>("/nil");
+  if (!ast_ret->expression) {
+    if (m_current_method->m_return_type != nil_type)
+      throw make_error<CodeGeneratorError>("method '",
+        m_current_method->name(), "' must return a value");
+    m_ir_builder.CreateRetVoid();
+    m_after_jump = true;
+    return;
+  }
   ast::dispatch(ast_ret->expression.get(), this);
   if (!m_expression_value)
     throw make_error<CodeGeneratorError>("return type must be a runtime value");
   if (m_expression_type != m_current_method->m_return_type)
     throw make_error<CodeGeneratorError>("value returned does not match method "
       "return type");
-  m_ir_builder.CreateRet(m_expression_value);
+  if (auto call = llvm::dyn_cast<llvm::CallInst>(m_expression_value))
+    markTailCall(call);
+  // the only values of type nil are the results of calls to nil methods
+  if (m_expression_type == nil_type)
+    m_ir_builder.CreateRetVoid();
+  else
+    m_ir_builder.CreateRet(m_expression_value);
   m_after_jump = true;
 }
 
+void CodeGenerator::markTailCall(llvm::CallInst* call)
+{
+  // The callee of a tail call reuses the stack frame of the caller, so it must
+  // not get pointers into that frame. Receivers which are passed in a stack
+  // slot end its lifetime after the call, so such calls aren't followed by the
+  // ret directly and are never tail calls.
+  if (call != &m_ir_builder.GetInsertBlock()->back()
+    || llvm::isa<llvm::IntrinsicInst>(call))
+    return;
+  for (auto& argument : call->args())
+    if (llvm::isa<llvm::AllocaInst>(argument->stripPointerCasts()))
+      return;
+
+  // musttail makes the code generator reuse the frame at every optimization
+  // level (or fail), but llvm only allows it when the callee has exactly the
+  // prototype and calling convention of the caller, which covers all self
+  // recursion and mutual recursion between methods of the same signature.
+  // Other calls are marked tail, which the code generator turns into a jump
+  // whenever the arguments fit into registers.
+  auto caller = m_current_method->m_llvm_function;
+  if (call->getFunctionType() == caller->getFunctionType()
+    && call->getCallingConv() == caller->getCallingConv())
+    call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  else
+    call->setTailCall();
+}
+
 void CodeGenerator::visit(ast::ExpressionStatement* ast_expression_statement)
 {
   if (m_after_jump)
@@ -783,7 +2074,7 @@ void CodeGenerator::visit(ast::ExpressionStatement* ast_expression_statement)
 void CodeGenerator::visit(ast::Assignment* ast_assignment)
 {
   // Get name of lhs variable
-  std::string lhs;
+  InternedString lhs;
   {
     auto lhs_identifier = ast::ast_cast<ast::Identifier*>(
       ast_assignment->left.get());
@@ -801,7 +2092,7 @@ void CodeGenerator::visit(ast::Assignment* ast_assignment)
       " a runtime value");
 
   SymbolTable::Variable* lhs_variable;
-  if (auto entry = m_symbol_table.lookup(lhs)) {
+  if (auto entry = m_method_symbol_table->lookup(lhs)) {
     // lhs is already defined
     lhs_variable = SymbolTable::sym_cast<SymbolTable::Variable*>(entry);
     if (!lhs_variable)
@@ -811,19 +2102,9 @@ void CodeGenerator::visit(ast::Assignment* ast_assignment)
       throw make_error<CodeGeneratorError>("type mismatch");
   }
   else {
-    lhs_variable = m_symbol_table.createVariable(lhs, m_expression_type);
-
-    auto old_insertion_point = m_ir_builder.saveIP();
-    m_ir_builder.SetInsertPoint(m_scope_entry_block,
-      m_scope_entry_block->begin()
-    );
-    lhs_variable->m_llvm_value = m_ir_builder.CreateAlloca(
-      lhs_variable->m_type->m_llvm_type, 0, nullptr, llvm::StringRef(
-        lhs_variable->path().data(), lhs_variable->path().size()
-    ));
-    m_ir_builder.restoreIP(old_insertion_point);
+    lhs_variable = createVariable(lhs, m_expression_type);
   }
-  m_ir_builder.CreateStore(m_expression_value, lhs_variable->m_llvm_value);
+  writeVariable(lhs_variable, m_ir_builder.GetInsertBlock(), m_expression_value);
 }
 
 void CodeGenerator::visit(ast::Call* ast_call)
@@ -834,8 +2115,8 @@ void CodeGenerator::visit(ast::Call* ast_call)
   // obtain the method being called
   SymbolTable::Method* method;
   {
-    auto scope = concatenate(m_expression_type->path(), '/');
-    auto entry = m_symbol_table.lookup(scope, ast_call->name);
+    auto entry = m_method_symbol_table->lookup(m_expression_type->path(),
+      ast_call->name);
     if (!entry)
       throw make_error<CodeGeneratorError>("method '", ast_call->name, "' does "
         "not exist on type '", m_expression_type->path(), '\'');
@@ -843,47 +2124,181 @@ void CodeGenerator::visit(ast::Call* ast_call)
       throw make_error<CodeGeneratorError>('\'', ast_call->name, "' in type '",
         m_expression_type->path(), "' is not a method");
   }
-  std::vector<llvm::Value*> arguments;
-  std::vector<llvm::Value*>::iterator arguments_iter;
-  if (m_expression_value) {
-    arguments.resize(method->m_argument_types.size() + 1);
-    auto old_insertion_point = m_ir_builder.saveIP();
-    m_ir_builder.SetInsertPoint(m_scope_entry_block, m_scope_entry_block->begin());
-    auto alloca_inst = m_ir_builder.CreateAlloca(m_expression_type->m_llvm_type,
-      0, nullptr, "temp");
-    m_ir_builder.restoreIP(old_insertion_point);
-    m_ir_builder.CreateStore(m_expression_value, alloca_inst);
-    arguments[0] = alloca_inst;
-    if (method->m_argument_types.size() != ast_call->arguments.size())
-      throw make_error<CodeGeneratorError>("argument count mismatch when callin"
-        "g method '", ast_call->name, "' on type '", m_expression_type->path(),
-        '\'');
-    arguments_iter = arguments.begin() + 1;
-  }
-  else {
-    arguments.resize(method->m_argument_types.size());
-    arguments_iter = arguments.begin();
+  if (method->m_argument_types.size() != ast_call->arguments.size())
+    throw make_error<CodeGeneratorError>("argument count mismatch when calling "
+      "method '", ast_call->name, "' on type '", m_expression_type->path(),
+      '\'');
+
+  // 'and' and 'or' on bools only evaluate their right operand when the left one
+  // doesn't decide the result already
+  if (m_expression_value && m_expression_type ==
+    m_method_symbol_table->gotoPath<SymbolTable::Type*>("/bool")
+    && (method->m_lowering == lowerAnd || method->m_lowering == lowerOr)) {
+    generateShortCircuit(ast_call->arguments[0].get(),
+      method->m_lowering == lowerAnd);
+    return;
   }
+
+  // evaluate the arguments, leaving room for the receiver in front
+  auto receiver_value = m_expression_value;
+  auto receiver_type = m_expression_type;
+  std::vector<llvm::Value*> arguments;
+  if (receiver_value)
+    arguments.push_back(receiver_value);
   auto argument_class_iter = method->m_argument_types.begin();
-  auto argument_expression_iter = ast_call->arguments.begin();
-  while (arguments_iter != arguments.end()) {
-    ast::dispatch((*argument_expression_iter).get(), this);
+  for (auto& ast_argument : ast_call->arguments) {
+    ast::dispatch(ast_argument.get(), this);
     if (!m_expression_value)
       throw std::runtime_error("cannot pass a class to a method");
     if (m_expression_type != *argument_class_iter)
       throw std::runtime_error("argument class mismatch");
-    *arguments_iter = m_expression_value;
+    arguments.push_back(m_expression_value);
     ++argument_class_iter;
-    ++argument_expression_iter;
-    ++arguments_iter;
+  }
+
+  if (receiver_value) {
+    // built-in methods with a lowering are emitted in place
+    if (method->m_lowering) {
+      auto block = m_ir_builder.GetInsertBlock();
+      m_expression_value = method->m_lowering(m_ir_builder, arguments);
+      m_expression_type = method->m_return_type;
+      // a lowering which branched continues in a block with no other
+      // predecessors than the one it started in, which can be sealed right away
+      if (m_ir_builder.GetInsertBlock() != block)
+        sealBlock(m_ir_builder.GetInsertBlock());
+      return;
     }
+    // otherwise primitives are passed by value and classes by pointer
+    // (in a stack slot which is only live for the duration of the call)
+    if (passedByPointer(receiver_type)) {
+      auto slot = acquireSlot(receiver_type->m_llvm_type);
+      m_ir_builder.CreateStore(receiver_value, slot);
+      arguments[0] = slot;
+      m_expression_value = m_ir_builder.CreateCall(method->m_llvm_function,
+        arguments);
+      releaseSlot(slot);
+      m_expression_type = method->m_return_type;
+      return;
+    }
+  }
   m_expression_value = m_ir_builder.CreateCall(method->m_llvm_function, arguments);
   m_expression_type = method->m_return_type;
 }
 
+void CodeGenerator::generateShortCircuit(ast::Expression* ast_right,
+  bool is_and)
+{
+  auto bool_type = m_method_symbol_table->gotoPath<SymbolTable::Type*>("/bool");
+  auto left_value = m_expression_value;
+  auto generateRight = [&] {
+    ast::dispatch(ast_right, this);
+    if (!m_expression_value || m_expression_type != bool_type)
+      throw make_error<CodeGeneratorError>("the right operand of '",
+        is_and ? "and" : "or", "' must be a boolean");
+  };
+
+  // Reading a variable or a literal costs nothing and has no side effects, so
+  // such a right operand is simply combined with the left one (which spares
+  // the optimizer from flattening the branches again).
+  if (ast::ast_cast<ast::Identifier*>(ast_right)
+    || ast::ast_cast<ast::Boolean*>(ast_right)) {
+    generateRight();
+    m_expression_value = is_and
+      ? m_ir_builder.CreateAnd(left_value, m_expression_value)
+      : m_ir_builder.CreateOr(left_value, m_expression_value);
+    return;
+  }
+
+  // Otherwise the right operand gets a block of its own which is skipped if
+  // the left operand is false (for 'and') or true (for 'or'). Expressions
+  // can't jump, so the right block always falls through to the merge block.
+  auto left_block = m_ir_builder.GetInsertBlock();
+  auto right_block = llvm::BasicBlock::Create(*m_context,
+    is_and ? "$and_right" : "$or_right", m_current_method->m_llvm_function);
+  auto merge_block = llvm::BasicBlock::Create(*m_context,
+    is_and ? "$and_merge" : "$or_merge", m_current_method->m_llvm_function);
+  if (is_and)
+    m_ir_builder.CreateCondBr(left_value, right_block, merge_block);
+  else
+    m_ir_builder.CreateCondBr(left_value, merge_block, right_block);
+  sealBlock(right_block);
+
+  m_ir_builder.SetInsertPoint(right_block);
+  generateRight();
+  auto right_value = m_expression_value;
+  auto right_end_block = m_ir_builder.GetInsertBlock();
+  m_ir_builder.CreateBr(merge_block);
+  sealBlock(merge_block);
+
+  m_ir_builder.SetInsertPoint(merge_block);
+  auto phi = m_ir_builder.CreatePHI(m_ir_builder.getInt1Ty(), 2);
+  phi->addIncoming(m_ir_builder.getInt1(!is_and), left_block);
+  phi->addIncoming(right_value, right_end_block);
+  m_expression_value = phi;
+  m_expression_type = bool_type;
+}
+
+llvm::MDNode* CodeGenerator::createLoopId(
+  const std::vector<ast::Annotation>& annotations)
+{
+  if (annotations.empty())
+    return nullptr;
+
+  // The annotations were checked by the parser. Every loop id refers to itself
+  // as its first operand, which keeps it distinct from the ids of other loops.
+  std::vector<llvm::Metadata*> operands{nullptr};
+  auto hint = [&](const char* name, llvm::Constant* value = nullptr) {
+    std::vector<llvm::Metadata*> hint_operands{
+      llvm::MDString::get(*m_context, name)};
+    if (value)
+      hint_operands.push_back(llvm::ConstantAsMetadata::get(value));
+    operands.push_back(llvm::MDNode::get(*m_context, hint_operands));
+  };
+  for (auto& annotation : annotations) {
+    auto name = annotation.name.view();
+    auto argument = annotation.argument
+      ? m_ir_builder.getInt32(static_cast<std::uint32_t>(*annotation.argument))
+      : nullptr;
+    if (name == "unroll") {
+      if (argument)
+        hint("llvm.loop.unroll.count", argument);
+      else
+        hint("llvm.loop.unroll.enable");
+    }
+    else if (name == "nounroll") {
+      hint("llvm.loop.unroll.disable");
+    }
+    else if (name == "vectorize") {
+      // a width of 1 asks for the loop not to be vectorized
+      if (!argument || *annotation.argument > 1)
+        hint("llvm.loop.vectorize.enable", m_ir_builder.getTrue());
+      if (argument)
+        hint("llvm.loop.vectorize.width", argument);
+    }
+    else if (name == "interleave") {
+      hint("llvm.loop.interleave.count", argument);
+    }
+    else {
+      BUCKET_UNREACHABLE();
+    }
+  }
+  auto loop_id = llvm::MDNode::getDistinct(*m_context, operands);
+  loop_id->replaceOperandWith(0, loop_id);
+  return loop_id;
+}
+
+void CodeGenerator::createBackEdge()
+{
+  // The optimizer only finds the metadata of a loop if every branch back to
+  // its entry block carries it
+  auto branch = m_ir_builder.CreateBr(m_loop_entry_block);
+  if (m_loop_id)
+    branch->setMetadata(llvm::LLVMContext::MD_loop, m_loop_id);
+}
+
 void CodeGenerator::visit(ast::Identifier* ast_identifier)
 {
-  auto entry = m_symbol_table.lookup(ast_identifier->value);
+  auto entry = m_method_symbol_table->lookup(ast_identifier->value);
   if (!entry)
     throw make_error<CodeGeneratorError>("unknown identifier '", ast_identifier->value, "'");
   if (auto type = SymbolTable::sym_cast<SymbolTable::Type*>(entry)) {
@@ -892,7 +2307,7 @@ void CodeGenerator::visit(ast::Identifier* ast_identifier)
   }
   else if (auto value = SymbolTable::sym_cast<SymbolTable::Variable*>(entry)) {
     m_expression_type = value->m_type;
-    m_expression_value = m_ir_builder.CreateLoad(value->m_llvm_value);
+    m_expression_value = readVariable(value, m_ir_builder.GetInsertBlock());
   }
   else {
     throw make_error<CodeGeneratorError>("identifier '", ast_identifier->value,
@@ -902,20 +2317,20 @@ void CodeGenerator::visit(ast::Identifier* ast_identifier)
 
 void CodeGenerator::visit(ast::Real* ast_real)
 {
-  m_expression_type = m_symbol_table.gotoPath<SymbolTable::Type*>("/real");
+  m_expression_type = m_method_symbol_table->gotoPath<SymbolTable::Type*>("/real");
   m_expression_value = llvm::ConstantFP::get(m_expression_type->m_llvm_type, ast_real->value);
 }
 
 void CodeGenerator::visit(ast::Integer* ast_integer)
 {
-  m_expression_type = m_symbol_table.gotoPath<SymbolTable::Type*>("/int");
+  m_expression_type = m_method_symbol_table->gotoPath<SymbolTable::Type*>("/int");
   m_expression_value = llvm::ConstantInt::getSigned(m_expression_type->m_llvm_type, ast_integer->value);
 }
 
 void CodeGenerator::visit(ast::Boolean* ast_bool)
 {
-  m_expression_type = m_symbol_table.gotoPath<SymbolTable::Type*>("/bool");
-  m_expression_value = ast_bool->value ? llvm::ConstantInt::getTrue(m_context) : llvm::ConstantInt::getFalse(m_context);
+  m_expression_type = m_method_symbol_table->gotoPath<SymbolTable::Type*>("/bool");
+  m_expression_value = ast_bool->value ? llvm::ConstantInt::getTrue(*m_context) : llvm::ConstantInt::getFalse(*m_context);
 }
 
 void CodeGenerator::visit(ast::String*)
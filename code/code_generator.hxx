@@ -14,16 +14,36 @@
 #define BUCKET_CODE_GENERATOR_HXX
 
 #include "abstract_syntax_tree.hxx"
+#include "method_cache.hxx"
+#include "optimization_level.hxx"
+#include "profile.hxx"
 #include "symbol_table.hxx"
+#include "target.hxx"
+#include <llvm/ADT/SmallString.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+#include <cstddef>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace llvm {
   class Value;
   class BasicBlock;
+  class PHINode;
+  class CallInst;
+  class AllocaInst;
+  class Type;
+  class MDNode;
 }
 
 class CodeGenerator : public ast::Visitor {
@@ -31,7 +51,18 @@ class CodeGenerator : public ast::Visitor {
 
 public:
 
-  CodeGenerator();
+  explicit CodeGenerator(std::size_t shard = 0, std::size_t shard_count = 1,
+    Target target = {});
+  // The methods of a program can be split between several code generators
+  // (shards). Every shard declares all the classes and methods of the program
+  // but only generates the bodies of every shard_count'th method, starting with
+  // the one at index shard, into a module of its own. Shards don't share any
+  // state, so they can be run on different threads. Only shard 0 creates the
+  // entry point. Use linkShard() to put the program back together.
+  //
+  // The code is generated for the given processor: every function gets it as
+  // attributes (so it also applies when the code is run in a JIT) and it is
+  // used for the native code generator.
 
   void printIR(std::optional<std::string> output_path = std::nullopt);
   void printBC(std::optional<std::string> output_path = std::nullopt);
@@ -39,26 +70,165 @@ public:
   // LLVM IR bytecode. If no argument is supplied, the code is written to
   // standard output.
 
+  void printAssembly(std::optional<std::string> output_path = std::nullopt);
+  void printObject(std::optional<std::string> output_path = std::nullopt);
+  // Compiles the generated code for the host machine and prints it as either
+  // assembly or an object file. If no argument is supplied, the code is
+  // written to standard output.
+
+  std::vector<llvm::SmallString<0>> compileObjects(unsigned jobs);
+  // Compiles the generated code for the host machine into one or more object
+  // files (which have to be linked together) and returns their contents. Large
+  // modules are split into partitions which are compiled concurrently on up to
+  // jobs threads. The number of partitions only depends on the module, so the
+  // objects are the same whatever the number of jobs.
+
+  std::vector<llvm::SmallString<0>> compileMethods(OptimizationLevel level,
+    unsigned jobs);
+  // Takes the place of optimize() and compileObjects() when a method cache is
+  // used (see useMethodCache()). Every method which was generated is optimized
+  // and compiled into an object file of its own, which is stored in the cache,
+  // and the objects of the methods which were skipped are loaded from it.
+  // Returns all of these objects (they have to be linked together). Since the
+  // methods are compiled separately they aren't inlined into each other, but
+  // the runtime still is. Methods are compiled on up to jobs threads.
+
+  void optimize(OptimizationLevel level, const Profile& profile = {});
+  // Runs llvm's default optimization pipeline for the given level over the
+  // generated code and sets the optimization level of the native code
+  // generator. Must be called after the program is visited. Above O0 the
+  // runtime is linked into the module first, with its functions made internal,
+  // so that they can be inlined and the unused ones are dropped. At O0 nothing
+  // is run (so the code is neither instrumented nor uses the profile). An
+  // instrumented program has to be linked with libbuiltin.a, which writes the
+  // profile.
+
+  void importInterface(std::string path);
+  // Makes the classes and methods in an interface file (written by
+  // exportInterface() when compiling another compilation unit) available to the
+  // program. Must be called before the program is visited.
+
+  void useMethodCache(const MethodCache& cache);
+  // Makes the code generator only declare the methods whose code is in the
+  // cache already, instead of generating them. Must be called before the
+  // program is visited. Use compileMethods() to compile the program.
+
+  void exportInterface(std::string path);
+  // Writes the classes and methods defined by the program to an interface file.
+  // Must be called after the program is visited.
+
+  void linkShard(CodeGenerator& shard);
+  // Links the module of another shard of the same program into the module of
+  // this code generator. Must be called after both shards visited the program.
+  // The other shard can't be used afterwards (see releaseModule()). The result
+  // is semantically equivalent to the program generated in a single shard, but
+  // not identical: the functions keep their order, while the other globals
+  // which only the other shard created (like string constants and intrinsic
+  // declarations) are appended, and those whose names collide are renamed.
+
+  std::pair<std::unique_ptr<llvm::LLVMContext>, std::unique_ptr<llvm::Module>>
+    releaseModule();
+  // Hands the generated code (and the context owning its types) over to the
+  // caller, e.g. to run it in a JIT. Must be called after the program is
+  // visited. Nothing but the destructor may be called afterwards.
+
 private:
 
   SymbolTable m_symbol_table;
-  llvm::LLVMContext m_context;
-  llvm::Module m_module;
+  std::optional<SymbolTable> m_method_symbol_table;
+  Target m_target;
+  std::unique_ptr<llvm::TargetMachine> m_target_machine;
+  std::unique_ptr<llvm::LLVMContext> m_context;
+  std::unique_ptr<llvm::Module> m_module;
   llvm::IRBuilder<> m_ir_builder;
   SymbolTable::Class* m_current_class;
   SymbolTable::Method* m_current_method;
   SymbolTable::Type* m_expression_type;
   llvm::Value* m_expression_value;
-  llvm::BasicBlock* m_scope_entry_block;
+  llvm::BasicBlock* m_entry_block;
   llvm::BasicBlock* m_loop_entry_block;
   llvm::BasicBlock* m_loop_merge_block;
+  llvm::MDNode* m_loop_id;
+  // The llvm.loop metadata of the innermost loop (nullptr if the loop has no
+  // annotations), which is attached to every branch back to its entry block
   bool m_after_jump;
+  const std::size_t m_shard;
+  const std::size_t m_shard_count;
+  std::size_t m_method_count;
+
+  // State of the SSA construction for the current method. Local variables are
+  // never stored in memory: every assignment records the value as the current
+  // definition of the variable in the current block, and reading a variable
+  // looks for the definition through the predecessors of the block, inserting
+  // phis where control flow merges (Braun et al., "Simple and Efficient
+  // Construction of Static Single Assignment Form"). A block is sealed once
+  // all of its predecessors are known. Phis created in blocks which aren't
+  // sealed yet get their operands when the block is sealed.
+  std::unordered_map<SymbolTable::Variable*,
+    std::unordered_map<llvm::BasicBlock*, llvm::WeakTrackingVH>> m_definitions;
+  std::unordered_map<llvm::BasicBlock*,
+    std::vector<std::pair<SymbolTable::Variable*, llvm::PHINode*>>>
+    m_incomplete_phis;
+  std::unordered_set<llvm::BasicBlock*> m_sealed_blocks;
+
+  // Stack slots of the current method which aren't in use, by type. Every
+  // alloca is emitted at the start of the entry block of the method (so that
+  // it runs once per call and can be promoted by mem2reg), and a slot is
+  // reused by any later temporary of the same type once its lifetime has
+  // ended.
+  std::unordered_map<llvm::Type*, std::vector<llvm::AllocaInst*>>
+    m_free_slots;
+
+  std::vector<std::string> m_interface_paths;
+  std::unordered_set<SymbolTable::Class*> m_imported_classes;
+
+  // The method cache (if one is used), the classes and methods of the program
+  // by their names (to find the ones a method refers to for its key) and the
+  // keys of the methods this code generator is responsible for, by the names
+  // of their llvm functions.
+  const MethodCache* m_method_cache;
+  std::unordered_multimap<std::string_view, SymbolTable::Class*>
+    m_classes_by_name;
+  std::unordered_multimap<std::string_view, SymbolTable::Method*>
+    m_methods_by_name;
+  std::unordered_map<std::string, std::string> m_method_keys;
 
   void initializeBuiltins();
+  void importInterfaces();
   void initializeClasses(ast::Program* ast_program);
   void initializeFieldsAndMethods(ast::Program* ast_program);
   void resolveClasses();
   void resolveMethods();
+  void indexReferences();
+  std::string describeReferences(ast::Method* ast_method);
+  void applyDecorators(SymbolTable::Method* method);
+  llvm::Function* declareMethod(SymbolTable::Method* method,
+    std::string_view link_name);
+  SymbolTable::Variable* createVariable(std::string_view name,
+    SymbolTable::Type* type);
+  void writeVariable(SymbolTable::Variable* variable, llvm::BasicBlock* block,
+    llvm::Value* value);
+  llvm::Value* readVariable(SymbolTable::Variable* variable,
+    llvm::BasicBlock* block);
+  llvm::Value* readVariableRecursive(SymbolTable::Variable* variable,
+    llvm::BasicBlock* block);
+  llvm::Value* addPhiOperands(SymbolTable::Variable* variable,
+    llvm::PHINode* phi);
+  llvm::Value* tryRemoveTrivialPhi(llvm::PHINode* phi);
+  void sealBlock(llvm::BasicBlock* block);
+  llvm::AllocaInst* acquireSlot(llvm::Type* type);
+  void releaseSlot(llvm::AllocaInst* slot);
+  void generateShortCircuit(ast::Expression* ast_right, bool is_and);
+  void markTailCall(llvm::CallInst* call);
+  llvm::MDNode* createLoopId(
+    const std::vector<ast::Annotation>& annotations);
+  void createBackEdge();
+
+  void printNative(std::optional<std::string> output_path,
+    llvm::CodeGenFileType file_type);
+
+  std::string classScope() const;
+  void createEntryPoint(SymbolTable::Method* module_main);
   void finalize();
 
   void visit(ast::Program*) override;
@@ -0,0 +1,35 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "compiler_identity.hxx"
+#include "miscellaneous.hxx"
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <sstream>
+
+std::string compilerIdentity()
+{
+  // A rebuilt compiler may generate different code for the same input, so the
+  // size and modification time of the executable are part of the identity
+  // (hashing its contents would take longer than most incremental builds).
+  std::ostringstream stream;
+  stream << LLVM_VERSION_STRING << '\n';
+  auto executable = llvm::sys::fs::getMainExecutable(nullptr,
+    reinterpret_cast<void*>(&compilerIdentity));
+  llvm::sys::fs::file_status status;
+  if (auto error_code = llvm::sys::fs::status(executable, status))
+    throw make_error<GeneralError>("unable to find the compiler executable: ",
+      error_code.message());
+  stream << executable << '\n' << status.getSize() << '\n'
+    << status.getLastModificationTime().time_since_epoch().count() << '\n';
+  return stream.str();
+}
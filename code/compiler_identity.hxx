@@ -0,0 +1,23 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_COMPILER_IDENTITY_HXX
+#define BUCKET_COMPILER_IDENTITY_HXX
+
+#include <string>
+
+std::string compilerIdentity();
+// Describes the running compiler (the llvm version and the size and
+// modification time of its executable) for the keys of caches whose contents
+// depend on the compiler that produced them.
+
+#endif
@@ -0,0 +1,489 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "constant_folder.hxx"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Statements = std::vector<std::unique_ptr<ast::Statement>>;
+
+std::unique_ptr<ast::Expression> makeInteger(std::int64_t value)
+{
+  auto ast_integer = std::make_unique<ast::Integer>();
+  ast_integer->value = value;
+  return ast_integer;
+}
+
+std::unique_ptr<ast::Expression> makeReal(double value)
+{
+  auto ast_real = std::make_unique<ast::Real>();
+  ast_real->value = value;
+  return ast_real;
+}
+
+std::unique_ptr<ast::Expression> makeBoolean(bool value)
+{
+  auto ast_boolean = std::make_unique<ast::Boolean>();
+  ast_boolean->value = value;
+  return ast_boolean;
+}
+
+// Returns a copy of an int, real or bool literal, or nullptr if the expression
+// is something else
+std::unique_ptr<ast::Expression> copyLiteral(ast::Expression* ast_expression)
+{
+  if (auto ast_integer = ast::ast_cast<ast::Integer*>(ast_expression))
+    return makeInteger(ast_integer->value);
+  if (auto ast_real = ast::ast_cast<ast::Real*>(ast_expression))
+    return makeReal(ast_real->value);
+  if (auto ast_boolean = ast::ast_cast<ast::Boolean*>(ast_expression))
+    return makeBoolean(ast_boolean->value);
+  return nullptr;
+}
+
+std::unique_ptr<ast::Expression> evaluateInt(std::int64_t left,
+  std::string_view name, std::int64_t right)
+{
+  // the arithmetic is done unsigned, where overflow wraps around like it does
+  // in the generated code
+  auto unsigned_left = static_cast<std::uint64_t>(left);
+  auto unsigned_right = static_cast<std::uint64_t>(right);
+  #ifdef BUCKET_BUILTIN_UBCHECK
+  // unless the generated code traps on overflow, in which case overflowing
+  // arithmetic is left to trap at run time
+  std::int64_t result;
+  if ((name == "__add__" && __builtin_add_overflow(left, right, &result))
+    || (name == "__sub__" && __builtin_sub_overflow(left, right, &result))
+    || (name == "__mul__" && __builtin_mul_overflow(left, right, &result)))
+    return nullptr;
+  #endif
+  if (name == "__add__")
+    return makeInteger(static_cast<std::int64_t>(unsigned_left
+      + unsigned_right));
+  if (name == "__sub__")
+    return makeInteger(static_cast<std::int64_t>(unsigned_left
+      - unsigned_right));
+  if (name == "__mul__")
+    return makeInteger(static_cast<std::int64_t>(unsigned_left
+      * unsigned_right));
+  // the divisions which fail at run time are left to fail there
+  bool divisible = right != 0
+    && !(left == std::numeric_limits<std::int64_t>::min() && right == -1);
+  if (name == "__div__")
+    return divisible ? makeInteger(left / right) : nullptr;
+  if (name == "__mod__")
+    return divisible ? makeInteger(left % right) : nullptr;
+  if (name == "__lt__")
+    return makeBoolean(left < right);
+  if (name == "__le__")
+    return makeBoolean(left <= right);
+  if (name == "__eq__")
+    return makeBoolean(left == right);
+  if (name == "__neq__")
+    return makeBoolean(left != right);
+  if (name == "__gt__")
+    return makeBoolean(left > right);
+  if (name == "__ge__")
+    return makeBoolean(left >= right);
+  return nullptr;
+}
+
+std::unique_ptr<ast::Expression> evaluateReal(double left,
+  std::string_view name, double right)
+{
+  // C++ compares NaNs the same way as the ordered (and for __neq__ unordered)
+  // comparisons of the generated code
+  if (name == "__add__")
+    return makeReal(left + right);
+  if (name == "__sub__")
+    return makeReal(left - right);
+  if (name == "__mul__")
+    return makeReal(left * right);
+  if (name == "__div__")
+    return makeReal(left / right);
+  if (name == "__lt__")
+    return makeBoolean(left < right);
+  if (name == "__le__")
+    return makeBoolean(left <= right);
+  if (name == "__eq__")
+    return makeBoolean(left == right);
+  if (name == "__neq__")
+    return makeBoolean(left != right);
+  if (name == "__gt__")
+    return makeBoolean(left > right);
+  if (name == "__ge__")
+    return makeBoolean(left >= right);
+  return nullptr;
+}
+
+// Evaluates a call of a builtin operator whose operands are literals. Returns
+// nullptr if the call can't be evaluated at compile time, including when it
+// is an error (which is then reported by the code generator).
+std::unique_ptr<ast::Expression> evaluate(ast::Call* ast_call)
+{
+  auto name = ast_call->name.view();
+  auto& ast_arguments = ast_call->arguments;
+
+  if (auto ast_boolean = ast::ast_cast<ast::Boolean*>(
+    ast_call->expression.get())) {
+    if (name == "__not__" && ast_arguments.empty())
+      return makeBoolean(!ast_boolean->value);
+    // The right operand has to be a literal too: otherwise it would be
+    // dropped or stand in for the call without being checked to be a bool
+    // (the code generator short-circuits the other calls anyway).
+    if (ast_arguments.size() != 1)
+      return nullptr;
+    auto ast_right = ast::ast_cast<ast::Boolean*>(ast_arguments[0].get());
+    if (!ast_right)
+      return nullptr;
+    if (name == "__and__")
+      return makeBoolean(ast_boolean->value && ast_right->value);
+    if (name == "__or__")
+      return makeBoolean(ast_boolean->value || ast_right->value);
+    return nullptr;
+  }
+
+  if (ast_arguments.size() != 1)
+    return nullptr;
+  if (auto ast_left = ast::ast_cast<ast::Integer*>(
+    ast_call->expression.get())) {
+    if (auto ast_right = ast::ast_cast<ast::Integer*>(ast_arguments[0].get()))
+      return evaluateInt(ast_left->value, name, ast_right->value);
+  }
+  else if (auto ast_left = ast::ast_cast<ast::Real*>(
+    ast_call->expression.get())) {
+    if (auto ast_right = ast::ast_cast<ast::Real*>(ast_arguments[0].get()))
+      return evaluateReal(ast_left->value, name, ast_right->value);
+  }
+  return nullptr;
+}
+
+// Returns whether the last statement of a block is a return, break or cycle,
+// after which the code of the block it is inlined into would be dead
+bool endsWithJump(const Statements& statements)
+{
+  if (statements.empty())
+    return false;
+  auto ast_statement = statements.back().get();
+  return ast::ast_cast<ast::Ret*>(ast_statement)
+    || ast::ast_cast<ast::Break*>(ast_statement)
+    || ast::ast_cast<ast::Cycle*>(ast_statement);
+}
+
+class ConstantFolder final : public ast::Visitor {
+public:
+
+  void visit(ast::Program* ast_program) override
+  {
+    for (auto& ast_global : ast_program->globals)
+      ast::dispatch(ast_global.get(), this);
+  }
+
+  void visit(ast::Class* ast_class) override
+  {
+    for (auto& ast_global : ast_class->globals)
+      ast::dispatch(ast_global.get(), this);
+  }
+
+  void visit(ast::Field*) override
+  {}
+
+  void visit(ast::Method* ast_method) override
+  {
+    std::unordered_set<InternedString> arguments{"this"};
+    for (auto& [name, type] : ast_method->arguments)
+      arguments.insert(name);
+
+    // Every constant which is propagated may make more expressions constant,
+    // so the method is folded again until there is nothing left to propagate.
+    std::unordered_set<InternedString> propagated;
+    for (;;) {
+      m_declarations.clear();
+      m_assignments.clear();
+      m_scopes.assign(1, arguments);
+      foldBlock(ast_method->statements);
+      m_constant_assignment = nullptr;
+      m_constant.reset();
+      m_substituting = false;
+      if (!findConstant(ast_method->statements, propagated))
+        break;
+      propagated.insert(m_constant_name);
+    }
+    m_scopes.clear();
+  }
+
+  void visit(ast::Declaration* ast_declaration) override
+  {
+    m_scopes.back().insert(ast_declaration->name);
+    ++m_declarations[ast_declaration->name];
+  }
+
+  void visit(ast::If* ast_if) override
+  {
+    fold(ast_if->condition);
+    bool if_declares = foldBlock(ast_if->if_body);
+    std::vector<bool> elif_declares;
+    for (auto& [ast_condition, ast_body] : ast_if->elif_bodies) {
+      fold(ast_condition);
+      elif_declares.push_back(foldBlock(ast_body));
+    }
+    bool else_declares = foldBlock(ast_if->else_body);
+
+    // Drop the branches whose conditions are false. A branch whose condition
+    // is true is taken whenever the ones before it aren't, so it replaces the
+    // else branch and the branches after it are dropped.
+    std::vector<std::pair<std::unique_ptr<ast::Expression>, Statements>>
+      branches;
+    std::vector<bool> branch_declares;
+    auto prune = [&](std::unique_ptr<ast::Expression>& ast_condition,
+      Statements& ast_body, bool declares) {
+      auto ast_boolean = ast::ast_cast<ast::Boolean*>(ast_condition.get());
+      if (!ast_boolean) {
+        branches.emplace_back(std::move(ast_condition), std::move(ast_body));
+        branch_declares.push_back(declares);
+        return false;
+      }
+      if (ast_boolean->value) {
+        ast_if->else_body = std::move(ast_body);
+        else_declares = declares;
+        return true;
+      }
+      return false;
+    };
+    if (!prune(ast_if->condition, ast_if->if_body, if_declares))
+      for (std::size_t i = 0; i < ast_if->elif_bodies.size(); ++i)
+        if (prune(ast_if->elif_bodies[i].first, ast_if->elif_bodies[i].second,
+          elif_declares[i]))
+          break;
+    ast_if->elif_bodies.clear();
+
+    if (branches.empty()) {
+      // Only the else branch is left. It is inlined unless that would move
+      // its variables into the enclosing scope or make the code after the if
+      // dead, in which case it is kept in an if of its own.
+      if (!else_declares && !endsWithJump(ast_if->else_body)) {
+        m_replacement_statements = std::move(ast_if->else_body);
+        return;
+      }
+      ast_if->condition = makeBoolean(true);
+      ast_if->if_body = std::move(ast_if->else_body);
+      ast_if->else_body.clear();
+      return;
+    }
+    ast_if->condition = std::move(branches.front().first);
+    ast_if->if_body = std::move(branches.front().second);
+    for (auto it = std::next(branches.begin()); it != branches.end(); ++it)
+      ast_if->elif_bodies.push_back(std::move(*it));
+  }
+
+  void visit(ast::InfiniteLoop* ast_infinite_loop) override
+  {
+    foldBlock(ast_infinite_loop->body);
+  }
+
+  void visit(ast::PreTestLoop* ast_pre_test_loop) override
+  {
+    fold(ast_pre_test_loop->condition);
+    foldBlock(ast_pre_test_loop->body);
+    foldBlock(ast_pre_test_loop->else_body);
+  }
+
+  void visit(ast::Break*) override
+  {}
+
+  void visit(ast::Cycle*) override
+  {}
+
+  void visit(ast::Ret* ast_ret) override
+  {
+    if (ast_ret->expression)
+      fold(ast_ret->expression);
+  }
+
+  void visit(ast::ExpressionStatement* ast_expression_statement) override
+  {
+    fold(ast_expression_statement->expression);
+  }
+
+  void visit(ast::Assignment* ast_assignment) override
+  {
+    fold(ast_assignment->right);
+    // an assignment to a name which isn't a variable yet declares it
+    if (auto ast_left = ast::ast_cast<ast::Identifier*>(
+      ast_assignment->left.get())) {
+      if (!isDeclared(ast_left->value))
+        m_scopes.back().insert(ast_left->value);
+      ++m_assignments[ast_left->value];
+    }
+  }
+
+  void visit(ast::Call* ast_call) override
+  {
+    fold(ast_call->expression);
+    for (auto& ast_argument : ast_call->arguments)
+      fold(ast_argument);
+    m_replacement = evaluate(ast_call);
+  }
+
+  void visit(ast::Identifier* ast_identifier) override
+  {
+    if (m_substituting && ast_identifier->value == m_constant_name)
+      m_replacement = copyLiteral(m_constant.get());
+  }
+
+  void visit(ast::Real*) override
+  {}
+
+  void visit(ast::Integer*) override
+  {}
+
+  void visit(ast::Boolean*) override
+  {}
+
+  void visit(ast::String*) override
+  {}
+
+  void visit(ast::Character*) override
+  {}
+
+private:
+
+  void fold(std::unique_ptr<ast::Expression>& ast_expression)
+  // Folds an expression, replacing it if it became a different node
+  {
+    ast::dispatch(ast_expression.get(), this);
+    if (m_replacement)
+      ast_expression = std::move(m_replacement);
+  }
+
+  void foldStatements(Statements& statements)
+  {
+    for (std::size_t i = 0; i < statements.size();) {
+      auto ast_statement = statements[i].get();
+      ast::dispatch(ast_statement, this);
+      if (m_replacement_statements) {
+        auto replacement = std::move(*m_replacement_statements);
+        m_replacement_statements.reset();
+        statements.erase(statements.begin() + i);
+        statements.insert(statements.begin() + i,
+          std::make_move_iterator(replacement.begin()),
+          std::make_move_iterator(replacement.end()));
+        i += replacement.size();
+      }
+      else {
+        ++i;
+      }
+      if (ast_statement == m_constant_assignment)
+        m_substituting = true;
+    }
+  }
+
+  bool foldBlock(Statements& statements)
+  // Folds a block of statements in a scope of its own. Returns whether the
+  // block declares variables.
+  {
+    m_scopes.emplace_back();
+    foldStatements(statements);
+    bool declares = !m_scopes.back().empty();
+    m_scopes.pop_back();
+    return declares;
+  }
+
+  bool isDeclared(InternedString name) const
+  {
+    for (auto& scope : m_scopes)
+      if (scope.count(name))
+        return true;
+    return false;
+  }
+
+  bool findConstant(const Statements& statements,
+    const std::unordered_set<InternedString>& propagated)
+  // Looks for a variable whose only assignment is one of the statements at the
+  // top level of the method and assigns a literal, and which isn't declared
+  // anywhere but before that statement at the top level. All uses of the
+  // variable after the assignment have the value of the literal.
+  {
+    std::unordered_set<InternedString> declared;
+    for (auto& ast_statement : statements) {
+      if (auto ast_declaration = ast::ast_cast<ast::Declaration*>(
+        ast_statement.get())) {
+        declared.insert(ast_declaration->name);
+        continue;
+      }
+      auto ast_expression_statement = ast::ast_cast<ast::ExpressionStatement*>(
+        ast_statement.get());
+      if (!ast_expression_statement)
+        continue;
+      auto ast_assignment = ast::ast_cast<ast::Assignment*>(
+        ast_expression_statement->expression.get());
+      if (!ast_assignment)
+        continue;
+      auto ast_left = ast::ast_cast<ast::Identifier*>(
+        ast_assignment->left.get());
+      if (!ast_left || propagated.count(ast_left->value))
+        continue;
+      auto name = ast_left->value;
+      auto constant = copyLiteral(ast_assignment->right.get());
+      auto declarations = m_declarations[name];
+      if (!constant || m_assignments[name] != 1 || declarations > 1
+        || (declarations == 1 && !declared.count(name)))
+        continue;
+      m_constant_name = name;
+      m_constant = std::move(constant);
+      m_constant_assignment = ast_statement.get();
+      return true;
+    }
+    return false;
+  }
+
+  std::unique_ptr<ast::Expression> m_replacement;
+  // Set by the visit of an expression which is to be replaced
+
+  std::optional<Statements> m_replacement_statements;
+  // Set by the visit of an if which is to be replaced by the statements of one
+  // of its branches (or by nothing)
+
+  std::vector<std::unordered_set<InternedString>> m_scopes;
+  // The variables declared in each of the enclosing blocks
+
+  std::unordered_map<InternedString, unsigned> m_declarations;
+  std::unordered_map<InternedString, unsigned> m_assignments;
+  // How often each name is declared or assigned in the current method
+
+  InternedString m_constant_name;
+  std::unique_ptr<ast::Expression> m_constant;
+  ast::Statement* m_constant_assignment = nullptr;
+  bool m_substituting = false;
+  // The variable which is being replaced by a constant, and whether its
+  // assignment has been passed yet
+
+};
+
+}
+
+void foldConstants(ast::Program* ast_program)
+{
+  ConstantFolder constant_folder;
+  ast::dispatch(ast_program, &constant_folder);
+}
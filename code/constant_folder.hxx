@@ -0,0 +1,32 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_CONSTANT_FOLDER_HXX
+#define BUCKET_CONSTANT_FOLDER_HXX
+
+#include "abstract_syntax_tree.hxx"
+
+void foldConstants(ast::Program* ast_program);
+// Simplifies the bodies of all methods before code is generated for them:
+//  - the builtin operators of int, real and bool on literals are evaluated
+//    (with the same results as at run time, so ints wrap around, and
+//    overflows which trap at run time (see BUCKET_BUILTIN_UBCHECK) and
+//    divisions by zero are left alone)
+//  - a local which is assigned a literal exactly once, by a statement at the
+//    top level of the method, is replaced by the literal after that statement
+//  - the branches of ifs whose conditions are literals are pruned: false
+//    branches are dropped and a true branch replaces the rest of the chain. A
+//    branch which is the only one left is inlined into the enclosing block,
+//    unless it declares variables or ends with a jump.
+// Code in pruned branches is dropped without being checked.
+
+#endif
@@ -0,0 +1,191 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "interface_file.hxx"
+#include "miscellaneous.hxx"
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+namespace {
+
+constexpr char magic[] = {'b', 'u', 'c', 'k', 'e', 't', 'i', 'f'};
+constexpr std::uint32_t version = 1;
+
+class Writer {
+public:
+  explicit Writer(std::ostream& stream);
+  void integer(std::size_t value);
+  void string(const std::string& value);
+  void strings(const std::vector<std::string>& value);
+private:
+  std::ostream& m_stream;
+};
+
+Writer::Writer(std::ostream& stream)
+: m_stream{stream}
+{}
+
+void Writer::integer(std::size_t value)
+{
+  if (value > UINT32_MAX)
+    throw make_error<GeneralError>("interface file entry is too large");
+  char bytes[4];
+  for (auto& byte : bytes) {
+    byte = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+  m_stream.write(bytes, sizeof(bytes));
+}
+
+void Writer::string(const std::string& value)
+{
+  integer(value.size());
+  m_stream.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+void Writer::strings(const std::vector<std::string>& value)
+{
+  integer(value.size());
+  for (auto& element : value)
+    string(element);
+}
+
+// Counts are checked against the number of bytes left in the stream (each
+// element takes at least element_size bytes), so that a corrupt file can't make
+// the reader allocate more than the file could possibly hold. Streams which
+// can't seek aren't bounded.
+class Reader {
+public:
+  explicit Reader(std::istream& stream);
+  std::uint32_t integer();
+  std::uint32_t count(std::size_t element_size);
+  std::string string();
+  std::vector<std::string> strings();
+private:
+  std::istream& m_stream;
+  std::uint64_t m_remaining;
+  void read(char* buffer, std::size_t size);
+};
+
+Reader::Reader(std::istream& stream)
+: m_stream{stream},
+  m_remaining{std::numeric_limits<std::uint64_t>::max()}
+{
+  auto position = stream.tellg();
+  if (position == std::istream::pos_type(-1))
+    return;
+  stream.seekg(0, std::ios_base::end);
+  auto end = stream.tellg();
+  stream.clear();
+  stream.seekg(position);
+  if (end != std::istream::pos_type(-1))
+    m_remaining = static_cast<std::uint64_t>(end - position);
+}
+
+void Reader::read(char* buffer, std::size_t size)
+{
+  if (size > m_remaining
+    || !m_stream.read(buffer, static_cast<std::streamsize>(size)))
+    throw make_error<InterfaceError>("truncated interface file");
+  m_remaining -= size;
+}
+
+std::uint32_t Reader::integer()
+{
+  unsigned char bytes[4];
+  read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+  return static_cast<std::uint32_t>(bytes[0])
+    | static_cast<std::uint32_t>(bytes[1]) << 8
+    | static_cast<std::uint32_t>(bytes[2]) << 16
+    | static_cast<std::uint32_t>(bytes[3]) << 24;
+}
+
+std::uint32_t Reader::count(std::size_t element_size)
+{
+  auto result = integer();
+  if (result > m_remaining / element_size)
+    throw make_error<InterfaceError>("truncated interface file");
+  return result;
+}
+
+std::string Reader::string()
+{
+  std::string result(count(1), '\0');
+  read(result.data(), result.size());
+  return result;
+}
+
+std::vector<std::string> Reader::strings()
+{
+  // every string starts with its length
+  std::vector<std::string> result(count(4));
+  for (auto& element : result)
+    element = string();
+  return result;
+}
+
+}
+
+void InterfaceFile::write(std::ostream& stream) const
+{
+  Writer writer{stream};
+  stream.write(magic, sizeof(magic));
+  writer.integer(version);
+  writer.integer(classes.size());
+  for (auto& sym_class : classes) {
+    writer.string(sym_class.path);
+    writer.integer(sym_class.fields.size());
+    for (auto& field : sym_class.fields) {
+      writer.string(field.name);
+      writer.string(field.type);
+    }
+  }
+  writer.integer(methods.size());
+  for (auto& method : methods) {
+    writer.string(method.path);
+    writer.string(method.link_name);
+    writer.strings(method.argument_types);
+    writer.string(method.return_type);
+  }
+}
+
+InterfaceFile InterfaceFile::read(std::istream& stream)
+{
+  char file_magic[sizeof(magic)];
+  if (!stream.read(file_magic, sizeof(file_magic))
+    || !std::equal(std::begin(magic), std::end(magic), file_magic))
+    throw make_error<InterfaceError>("not a bucket interface file");
+  Reader reader{stream};
+  if (auto file_version = reader.integer(); file_version != version)
+    throw make_error<InterfaceError>("unsupported interface file version ",
+      file_version);
+  InterfaceFile result;
+  // the least every entry takes is the lengths of its strings and vectors
+  result.classes.resize(reader.count(8));
+  for (auto& sym_class : result.classes) {
+    sym_class.path = reader.string();
+    sym_class.fields.resize(reader.count(8));
+    for (auto& field : sym_class.fields) {
+      field.name = reader.string();
+      field.type = reader.string();
+    }
+  }
+  result.methods.resize(reader.count(16));
+  for (auto& method : result.methods) {
+    method.path = reader.string();
+    method.link_name = reader.string();
+    method.argument_types = reader.strings();
+    method.return_type = reader.string();
+  }
+  return result;
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_INTERFACE_FILE_HXX
+#define BUCKET_INTERFACE_FILE_HXX
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct InterfaceFile {
+// The public part of the symbol table of a compilation unit: its classes (with
+// their fields in layout order) and its methods (with their signatures and the
+// names of the llvm functions implementing them). Types are referred to by
+// their symbol table paths. A compilation unit which depends on another one
+// loads that unit's interface file instead of analyzing its source.
+//
+// On disk an interface file is the magic string "bucketif", a version number
+// and then the classes and methods. Integers are stored as 32 bit little endian
+// numbers and strings are stored as their length followed by their bytes.
+
+  struct Field {
+    std::string name;
+    std::string type;
+  };
+
+  struct Class {
+    std::string path;
+    std::vector<Field> fields;
+  };
+
+  struct Method {
+    std::string path;
+    std::string link_name;
+    std::vector<std::string> argument_types;
+    std::string return_type;
+  };
+
+  std::vector<Class> classes;
+  std::vector<Method> methods;
+
+  void write(std::ostream& stream) const;
+  static InterfaceFile read(std::istream& stream);
+  // Serialize and deserialize an interface file. read() throws an
+  // InterfaceError if the stream doesn't contain a valid interface file.
+
+};
+
+#endif
@@ -0,0 +1,112 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "jit.hxx"
+#include "builtin.hxx"
+#include "miscellaneous.hxx"
+#include <cstdint>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/JITSymbol.h>
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#if LLVM_VERSION_MAJOR >= 12
+#include <llvm/ExecutionEngine/Orc/Mangling.h>
+#endif
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/Error.h>
+#include <utility>
+
+namespace {
+
+template <typename T>
+T unwrap(llvm::Expected<T> expected)
+{
+  if (!expected)
+    throw make_error<GeneralError>("jit error: ",
+      llvm::toString(expected.takeError()));
+  return std::move(*expected);
+}
+
+void check(llvm::Error error)
+{
+  if (error)
+    throw make_error<GeneralError>("jit error: ",
+      llvm::toString(std::move(error)));
+}
+
+// The functions of the runtime (see builtin.hxx), which are linked into the
+// compiler so that the JIT doesn't have to look them up in the process
+#define BUCKET_RUNTIME_FUNCTIONS(X) \
+  X(bucket_bool_and) X(bucket_bool_or) X(bucket_bool_not) \
+  X(bucket_bool_print) \
+  X(bucket_int_add) X(bucket_int_sub) X(bucket_int_mul) X(bucket_int_div) \
+  X(bucket_int_mod) X(bucket_int_lt) X(bucket_int_le) X(bucket_int_eq) \
+  X(bucket_int_ne) X(bucket_int_gt) X(bucket_int_ge) X(bucket_int_print) \
+  X(bucket_real_add) X(bucket_real_sub) X(bucket_real_mul) \
+  X(bucket_real_div) X(bucket_real_lt) X(bucket_real_le) X(bucket_real_eq) \
+  X(bucket_real_ne) X(bucket_real_gt) X(bucket_real_ge) \
+  X(bucket_real_print) \
+  X(bucket_byte_and) X(bucket_byte_or) X(bucket_byte_xor) \
+  X(bucket_byte_not) X(bucket_byte_lshift) X(bucket_byte_rshift) \
+  X(bucket_byte_print) \
+  X(bucket_system_test)
+
+llvm::orc::SymbolMap runtimeSymbols(llvm::orc::MangleAndInterner& mangle)
+{
+  llvm::orc::SymbolMap symbols;
+  #define BUCKET_DEFINE_SYMBOL(name) \
+    symbols[mangle(#name)] = llvm::JITEvaluatedSymbol( \
+      llvm::pointerToJITTargetAddress(&name), llvm::JITSymbolFlags::Exported);
+  BUCKET_RUNTIME_FUNCTIONS(BUCKET_DEFINE_SYMBOL)
+  #undef BUCKET_DEFINE_SYMBOL
+  return symbols;
+}
+
+}
+
+int runProgram(CodeGenerator& code_generator)
+{
+  auto [context, module] = code_generator.releaseModule();
+
+  auto jit = unwrap(llvm::orc::LLLazyJITBuilder{}
+    .setJITTargetMachineBuilder(llvm::orc::JITTargetMachineBuilder{
+      llvm::Triple{module->getTargetTriple()}})
+    .create());
+
+  llvm::orc::MangleAndInterner mangle{jit->getExecutionSession(),
+    jit->getDataLayout()};
+  check(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols(
+    runtimeSymbols(mangle))));
+  // an optimized module contains the runtime itself, which calls into the C
+  // library
+  jit->getMainJITDylib().addGenerator(unwrap(
+    llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      jit->getDataLayout().getGlobalPrefix())));
+
+  // addLazyIRModule() splits the module into one partition per function and
+  // only compiles a function when a call to it first goes through its stub
+  check(jit->addLazyIRModule(llvm::orc::ThreadSafeModule{std::move(module),
+    std::move(context)}));
+
+  // The program is run through its C entry point, which turns the result of
+  // /main/main into the exit status. /main/main itself returns an i1, which
+  // isn't guaranteed to be extended to the bool of a C++ caller.
+  auto entry_point = unwrap(jit->lookup("main"));
+  auto function = reinterpret_cast<int(*)(int, char**)>(
+    static_cast<std::uintptr_t>(entry_point.getAddress()));
+  char program_name[] = "bucket";
+  char* arguments[] = {program_name, nullptr};
+  return function(1, arguments);
+}
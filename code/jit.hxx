@@ -0,0 +1,28 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_JIT_HXX
+#define BUCKET_JIT_HXX
+
+#include "code_generator.hxx"
+
+int runProgram(CodeGenerator& code_generator);
+// Runs the generated code inside the compiler process with llvm's ORC JIT and
+// returns the exit status of the program (the one the entry point of an
+// executable returns: 0 if /main/main returns true and 1 otherwise). Methods
+// are compiled lazily the first time they are called, so methods that never
+// run are never compiled. The built-in methods are resolved to the runtime
+// linked into the compiler itself (unless the optimizer linked the runtime into
+// the module) and the C library is looked up in the compiler process. Takes the
+// module away from the code generator (see CodeGenerator::releaseModule()).
+
+#endif
@@ -531,7 +531,7 @@ static Token lex(SourceFile& source_file, SourceFile::iterator iter)
       else if (string == "false")
         return Token::createBooleanLiteral(false, begin, iter);
       else
-        return Token::createIdentifier(std::move(string), begin, iter);
+        return Token::createIdentifier(InternedString(string), begin, iter);
     }
 
     case '.':
@@ -0,0 +1,339 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "linker.hxx"
+#include "miscellaneous.hxx"
+#include <llvm/Support/raw_ostream.h>
+#include <system_error>
+#include <utility>
+
+namespace {
+
+void writeObject(const llvm::SmallString<0>& object,
+  const std::string& output_path)
+{
+  std::error_code error_code;
+  llvm::raw_fd_ostream stream{output_path, error_code};
+  if (error_code)
+    throw make_error<GeneralError>("unable to open output file: ",
+      error_code.message());
+  stream << object.str();
+}
+
+}
+
+#ifdef BUCKET_USE_LLD
+
+#include <lld/Common/Driver.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Path.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Object files written to temporary files, which are removed when this goes out
+// of scope
+class TemporaryFiles {
+public:
+  TemporaryFiles() = default;
+  TemporaryFiles(const TemporaryFiles&) = delete;
+  TemporaryFiles& operator=(const TemporaryFiles&) = delete;
+  ~TemporaryFiles();
+  const char* create(llvm::StringRef contents);
+  // returns the path of the new file
+private:
+  std::vector<std::string> m_paths;
+};
+
+TemporaryFiles::~TemporaryFiles()
+{
+  for (auto& path : m_paths)
+    llvm::sys::fs::remove(path);
+}
+
+const char* TemporaryFiles::create(llvm::StringRef contents)
+{
+  llvm::SmallString<128> path;
+  int file_descriptor;
+  if (auto error_code = llvm::sys::fs::createTemporaryFile("bucket", "o",
+    file_descriptor, path))
+    throw make_error<GeneralError>("unable to create temporary file: ",
+      error_code.message());
+  m_paths.push_back(path.str().str());
+  llvm::raw_fd_ostream stream{file_descriptor, true};
+  stream << contents;
+  stream.close();
+  if (stream.has_error())
+    throw make_error<GeneralError>("unable to write temporary file: ",
+      stream.error().message());
+  return m_paths.back().c_str();
+}
+
+std::string runtimePath()
+{
+  // use the address of a function in this executable so that this works even
+  // when /proc isn't available
+  llvm::SmallString<256> path{llvm::sys::fs::getMainExecutable(nullptr,
+    reinterpret_cast<void*>(&runtimePath))};
+  llvm::sys::path::remove_filename(path);
+  llvm::sys::path::append(path, "libbuiltin.a");
+  if (!llvm::sys::fs::exists(path))
+    throw make_error<GeneralError>("unable to find the runtime library at '",
+      path.str().str(), '\'');
+  return path.str().str();
+}
+
+// Where the C library and the C compiler of a linux system keep the files an
+// executable for the target is linked with, which are found from the triple
+// (the code generator compiles for the default triple) and the multiarch layout
+// of debian. Each of them can be overridden at build time.
+struct SystemPaths {
+  std::string libc_directory;
+  std::string dynamic_linker;
+  std::string crt_directory;
+};
+
+// Finds the directory of crtbeginS.o and crtendS.o, which run the constructors
+// and destructors of the program and define __dso_handle (which atexit()
+// needs). They come with the C compiler rather than the C library, so the one
+// of the newest gcc in gcc_directory is used.
+std::string crtDirectory(const std::string& gcc_directory)
+{
+  std::string directory;
+  std::error_code error_code;
+  for (llvm::sys::fs::directory_iterator iterator{gcc_directory, error_code},
+    end; !error_code && iterator != end; iterator.increment(error_code)) {
+    llvm::SmallString<256> crtbegin_path{iterator->path()};
+    llvm::sys::path::append(crtbegin_path, "crtbeginS.o");
+    if (!llvm::sys::fs::exists(crtbegin_path))
+      continue;
+    auto version = llvm::sys::path::filename(iterator->path());
+    if (directory.empty() || version.compare_numeric(
+      llvm::sys::path::filename(directory)) > 0)
+      directory = iterator->path();
+  }
+  if (directory.empty())
+    throw make_error<GeneralError>("unable to find crtbeginS.o in '",
+      gcc_directory, "', build bucket with BUCKET_CRT_DIR set to its "
+      "directory");
+  return directory;
+}
+
+SystemPaths systemPaths()
+{
+  llvm::Triple triple{llvm::sys::getDefaultTargetTriple()};
+  if (!triple.isOSLinux() || triple.getEnvironment() != llvm::Triple::GNU)
+    throw make_error<GeneralError>("executables can only be linked for "
+      "linux with the gnu C library, not for ", triple.str());
+  const char* dynamic_linker;
+  switch (triple.getArch()) {
+  case llvm::Triple::x86_64:
+    dynamic_linker = "/lib64/ld-linux-x86-64.so.2";
+    break;
+  case llvm::Triple::aarch64:
+    dynamic_linker = "/lib/ld-linux-aarch64.so.1";
+    break;
+  case llvm::Triple::ppc64le:
+    dynamic_linker = "/lib64/ld64.so.2";
+    break;
+  case llvm::Triple::riscv64:
+    dynamic_linker = "/lib/ld-linux-riscv64-lp64d.so.1";
+    break;
+  default:
+    throw make_error<GeneralError>("executables can't be linked for ",
+      triple.str());
+  }
+  // debian names the directories after the architecture and the system, e.g.
+  // x86_64-linux-gnu
+  auto multiarch = concatenate(
+    llvm::Triple::getArchTypeName(triple.getArch()).str(), "-linux-gnu");
+
+  SystemPaths paths;
+  #ifdef BUCKET_LIBC_DIR
+  paths.libc_directory = BUCKET_LIBC_DIR;
+  #else
+  paths.libc_directory = concatenate("/usr/lib/", multiarch);
+  #endif
+  #ifdef BUCKET_DYNAMIC_LINKER
+  paths.dynamic_linker = BUCKET_DYNAMIC_LINKER;
+  #else
+  paths.dynamic_linker = dynamic_linker;
+  #endif
+  #ifdef BUCKET_CRT_DIR
+  paths.crt_directory = BUCKET_CRT_DIR;
+  #elif defined(BUCKET_GCC_DIR)
+  paths.crt_directory = crtDirectory(BUCKET_GCC_DIR);
+  #else
+  paths.crt_directory = crtDirectory(concatenate("/usr/lib/gcc/", multiarch));
+  #endif
+
+  if (!llvm::sys::fs::exists(paths.libc_directory + "/Scrt1.o"))
+    throw make_error<GeneralError>("unable to find Scrt1.o in '",
+      paths.libc_directory, "', build bucket with BUCKET_LIBC_DIR set to its "
+      "directory");
+  return paths;
+}
+
+// The files an executable is linked with besides its own objects
+struct LinkedInputs {
+  std::string runtime;
+  std::string libc_directory;
+  std::string dynamic_linker;
+  std::string scrt1;
+  std::string crti;
+  std::string crtbegin;
+  std::string crtend;
+  std::string crtn;
+};
+
+LinkedInputs linkedInputs()
+{
+  auto paths = systemPaths();
+  return {
+    runtimePath(),
+    paths.libc_directory,
+    paths.dynamic_linker,
+    paths.libc_directory + "/Scrt1.o",
+    paths.libc_directory + "/crti.o",
+    paths.crt_directory + "/crtbeginS.o",
+    paths.crt_directory + "/crtendS.o",
+    paths.libc_directory + "/crtn.o"
+  };
+}
+
+void runLLD(const std::vector<const char*>& arguments)
+{
+  std::string messages;
+  llvm::raw_string_ostream messages_stream{messages};
+  #if LLVM_VERSION_MAJOR >= 14
+  bool success = lld::elf::link(arguments, messages_stream, messages_stream,
+    false, false);
+  #else
+  bool success = lld::elf::link(arguments, false, messages_stream,
+    messages_stream);
+  #endif
+  if (!success)
+    throw make_error<GeneralError>("linking failed:\n", messages_stream.str());
+}
+
+}
+
+void linkExecutable(const std::vector<llvm::SmallString<0>>& objects,
+  const std::string& output_path)
+{
+  auto inputs = linkedInputs();
+
+  // the code generator emits position independent code, so link a position
+  // independent executable
+  std::vector<const char*> arguments{
+    "ld.lld",
+    "-o", output_path.c_str(),
+    "-pie",
+    "--eh-frame-hdr",
+    "-dynamic-linker", inputs.dynamic_linker.c_str(),
+    inputs.scrt1.c_str(),
+    inputs.crti.c_str(),
+    inputs.crtbegin.c_str()
+  };
+  TemporaryFiles object_files;
+  for (auto& object : objects)
+    arguments.push_back(object_files.create(object.str()));
+  arguments.insert(arguments.end(), {
+    inputs.runtime.c_str(),
+    "-L", inputs.libc_directory.c_str(),
+    "-lc",
+    inputs.crtend.c_str(),
+    inputs.crtn.c_str()
+  });
+  runLLD(arguments);
+}
+
+void linkExecutable(CodeGenerator& code_generator,
+  const std::string& output_path, unsigned jobs)
+{
+  linkExecutable(code_generator.compileObjects(jobs), output_path);
+}
+
+std::vector<std::string> linkedFiles()
+{
+  auto inputs = linkedInputs();
+  return {inputs.runtime, inputs.scrt1, inputs.crti, inputs.crtbegin,
+    inputs.crtend, inputs.crtn};
+}
+
+void linkObject(const std::vector<llvm::SmallString<0>>& objects,
+  const std::string& output_path)
+{
+  if (objects.size() == 1) {
+    writeObject(objects[0], output_path);
+    return;
+  }
+  std::vector<const char*> arguments{"ld.lld", "-r", "-o",
+    output_path.c_str()};
+  TemporaryFiles object_files;
+  for (auto& object : objects)
+    arguments.push_back(object_files.create(object.str()));
+  runLLD(arguments);
+}
+
+void linkObject(CodeGenerator& code_generator,
+  std::optional<std::string> output_path, unsigned jobs)
+{
+  if (!output_path) {
+    code_generator.printObject(std::move(output_path));
+    return;
+  }
+  linkObject(code_generator.compileObjects(jobs), *output_path);
+}
+
+#else
+
+void linkExecutable(const std::vector<llvm::SmallString<0>>&,
+  const std::string&)
+{
+  throw make_error<GeneralError>("bucket was built without lld, use --obj and "
+    "a linker to create executables");
+}
+
+void linkExecutable(CodeGenerator&, const std::string&, unsigned)
+{
+  throw make_error<GeneralError>("bucket was built without lld, use --obj and "
+    "a linker to create executables");
+}
+
+std::vector<std::string> linkedFiles()
+{
+  return {};
+}
+
+void linkObject(const std::vector<llvm::SmallString<0>>& objects,
+  const std::string& output_path)
+{
+  if (objects.size() != 1)
+    throw make_error<GeneralError>("bucket was built without lld, so it "
+      "can't combine several object files into one");
+  writeObject(objects[0], output_path);
+}
+
+void linkObject(CodeGenerator& code_generator,
+  std::optional<std::string> output_path, unsigned)
+{
+  // without lld the partitions can't be combined
+  code_generator.printObject(std::move(output_path));
+}
+
+#endif
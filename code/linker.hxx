@@ -0,0 +1,57 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_LINKER_HXX
+#define BUCKET_LINKER_HXX
+
+#include "code_generator.hxx"
+#include <llvm/ADT/SmallString.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+void linkExecutable(CodeGenerator& code_generator,
+  const std::string& output_path, unsigned jobs);
+// Compiles the generated code to an object file and links it with the
+// prebuilt runtime (libbuiltin.a, which is looked up next to the bucket
+// executable) and the C library into a Linux executable. Linking happens inside
+// the compiler process with lld, so bucket must be built with BUCKET_USE_LLD
+// (which is off by default) for this to work, otherwise a GeneralError is
+// thrown. Only linux with the gnu C library is supported. The C library's
+// startup files, the dynamic loader and the C compiler's crtbeginS.o and
+// crtendS.o are looked up for the architecture of the target in the multiarch
+// directories of debian (like /usr/lib/x86_64-linux-gnu). Other layouts can be
+// set at build time with BUCKET_LIBC_DIR, BUCKET_DYNAMIC_LINKER and
+// BUCKET_CRT_DIR (or BUCKET_GCC_DIR, whose newest version is used). The code is
+// compiled on up to jobs threads (see CodeGenerator::compileObjects()).
+
+std::vector<std::string> linkedFiles();
+// Returns the paths of the files linkExecutable() links into every executable
+// (the runtime and the startup files), e.g. so that a cache of executables can
+// tell when they change. Returns nothing without lld.
+
+void linkObject(CodeGenerator& code_generator,
+  std::optional<std::string> output_path, unsigned jobs);
+// Like CodeGenerator::printObject(), but compiles the code on up to jobs
+// threads (see CodeGenerator::compileObjects()) and combines the resulting
+// objects into one with a relocatable link. Without lld (or when writing to
+// standard output) the code is compiled on a single thread.
+
+void linkExecutable(const std::vector<llvm::SmallString<0>>& objects,
+  const std::string& output_path);
+void linkObject(const std::vector<llvm::SmallString<0>>& objects,
+  const std::string& output_path);
+// Like the functions above, but for code which was compiled already (e.g. by
+// CodeGenerator::compileMethods()). Without lld only a single object can be
+// written.
+
+#endif
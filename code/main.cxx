@@ -1,9 +1,13 @@
+#include "optimization_level.hxx"
+#include "profile.hxx"
 #include "run_compiler.hxx"
+#include "target.hxx"
 #include <boost/program_options.hpp>
 #include <cstdlib>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace po = boost::program_options;
 
@@ -22,6 +26,30 @@ int main(int argc, char* argv[])
       ("version", "print version info")
       ("input-file", po::value<std::string>(), "sets the input file")
       ("output-file", po::value<std::string>(), "sets the output file")
+      ("import", po::value<std::vector<std::string>>(), "loads the interface "
+        "file of a compilation unit the input depends on")
+      ("emit-interface", po::value<std::string>(), "writes the interface file "
+        "of the input to the given path")
+      ("optimize,O", po::value<std::string>()->default_value("0"), "sets the "
+        "optimization level (0, 1, 2, 3 or s)")
+      ("march", po::value<std::string>()->default_value("generic"), "sets the "
+        "processor to generate code for (native uses the one of this machine)")
+      ("mtune", po::value<std::string>(), "sets the processor to tune the "
+        "code for (defaults to the one of -march)")
+      ("jobs,j", po::value<unsigned>()->default_value(1), "sets the number of "
+        "threads generating code (0 or more than the cores use one per core)")
+      ("method-cache", po::value<std::string>(), "keeps the object code of "
+        "every method in the given directory and only recompiles the methods "
+        "which changed (for --obj and executables)")
+      ("cache", po::value<std::string>(), "keeps the output in the given "
+        "directory and reuses it when the same input is compiled with the same "
+        "flags again (when the output is a single file)")
+      ("profile-generate", po::value<std::string>()->implicit_value(""),
+        "instruments the code to write a profile of every run to the given "
+        "path (default.profraw, or LLVM_PROFILE_FILE) when it exits")
+      ("profile-use", po::value<std::string>(), "optimizes the code using a "
+        "profile (made from the ones of --profile-generate with llvm-profdata "
+        "merge)")
       ("read", "reads the input file")
       ("lex", "turns the input into a list of tokens")
       ("parse", "turns the input into an abstract syntax tree")
@@ -29,7 +57,9 @@ int main(int argc, char* argv[])
       ("bc", "compiles the input into llvm bitcode")
       ("asm", "compiles the input into assembly")
       ("obj", "compiles the input into an object file")
-      ("exec", "compiles and links the input into an executable")
+      ("exec", "compiles and links the input into an executable (only if "
+        "bucket was built with BUCKET_USE_LLD)")
+      ("run", "compiles the input and runs it right away")
     ;
 
     po::positional_options_description positional_options_description;
@@ -40,6 +70,9 @@ int main(int argc, char* argv[])
     po::store(
       po::command_line_parser(argc, argv)
         .options(options_description)
+        // accept long options with a single dash too, like -march=native
+        .style(po::command_line_style::default_style
+          | po::command_line_style::allow_long_disguise)
         .positional(positional_options_description)
         .run(),
       variables_map
@@ -60,9 +93,57 @@ int main(int argc, char* argv[])
       if (variables_map.count("output-file")) {
         output_path_optional = variables_map["output-file"].as<std::string>();
       }
-      run_compiler(
+      std::vector<std::string> import_paths;
+      if (variables_map.count("import")) {
+        import_paths = variables_map["import"].as<std::vector<std::string>>();
+      }
+      std::optional<std::string> interface_path_optional;
+      if (variables_map.count("emit-interface")) {
+        interface_path_optional =
+          variables_map["emit-interface"].as<std::string>();
+      }
+      std::optional<std::string> method_cache_path_optional;
+      if (variables_map.count("method-cache")) {
+        method_cache_path_optional =
+          variables_map["method-cache"].as<std::string>();
+      }
+      std::optional<std::string> cache_path_optional;
+      if (variables_map.count("cache")) {
+        cache_path_optional = variables_map["cache"].as<std::string>();
+      }
+      std::string tune;
+      if (variables_map.count("mtune")) {
+        tune = variables_map["mtune"].as<std::string>();
+      }
+      Profile profile;
+      if (variables_map.count("profile-generate")) {
+        profile.mode = Profile::Mode::Generate;
+        profile.path = variables_map["profile-generate"].as<std::string>();
+      }
+      if (variables_map.count("profile-use")) {
+        if (variables_map.count("profile-generate")) {
+          throw std::runtime_error("--profile-generate and --profile-use "
+            "can't be combined");
+        }
+        profile.mode = Profile::Mode::Use;
+        profile.path = variables_map["profile-use"].as<std::string>();
+      }
+      auto optimization_level = string2OptimizationLevel(
+        variables_map["optimize"].as<std::string>());
+      if (!optimization_level) {
+        throw std::runtime_error("invalid optimization level");
+      }
+      return run_compiler(
         input_path,
         output_path_optional,
+        import_paths,
+        interface_path_optional,
+        *optimization_level,
+        string2Target(variables_map["march"].as<std::string>(), tune),
+        profile,
+        variables_map["jobs"].as<unsigned>(),
+        method_cache_path_optional,
+        cache_path_optional,
         variables_map.count("read"),
         variables_map.count("lex"),
         variables_map.count("parse"),
@@ -70,7 +151,8 @@ int main(int argc, char* argv[])
         variables_map.count("bc"),
         variables_map.count("asm"),
         variables_map.count("obj"),
-        variables_map.count("exec")
+        variables_map.count("exec"),
+        variables_map.count("run")
       );
     }
   } catch (const std::exception& e) {
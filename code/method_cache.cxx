@@ -0,0 +1,100 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "method_cache.hxx"
+#include "compiler_identity.hxx"
+#include "miscellaneous.hxx"
+#include <iomanip>
+#include <limits>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <sstream>
+#include <system_error>
+#include <utility>
+
+MethodCache::MethodCache(std::string directory, OptimizationLevel level,
+  const Target& target)
+: m_directory{std::move(directory)},
+  m_compiler{"bucket method cache 1\n" + compilerIdentity()
+    + std::to_string(static_cast<int>(level)) + '\n' + target2String(target)
+    + '\n'}
+{
+  if (auto error_code = llvm::sys::fs::create_directories(m_directory))
+    throw make_error<GeneralError>("unable to create the method cache '",
+      m_directory, "': ", error_code.message());
+}
+
+std::string MethodCache::key(std::string_view path, ast::Method& ast_method,
+  std::string_view references) const
+{
+  std::ostringstream stream;
+  // print reals exactly, so that changing a literal changes the key
+  stream << std::setprecision(std::numeric_limits<double>::max_digits10);
+  stream << m_compiler << path << '\n' << references << '\n' << ast_method;
+  llvm::MD5 md5;
+  md5.update(stream.str());
+  llvm::MD5::MD5Result result;
+  md5.final(result);
+  return result.digest().str().str();
+}
+
+bool MethodCache::contains(const std::string& key) const
+{
+  return llvm::sys::fs::exists(path(key));
+}
+
+llvm::SmallString<0> MethodCache::load(const std::string& key) const
+{
+  auto buffer = llvm::MemoryBuffer::getFile(path(key));
+  if (!buffer)
+    throw make_error<GeneralError>("unable to read cached method ", key, ": ",
+      buffer.getError().message());
+  return llvm::SmallString<0>{(*buffer)->getBuffer()};
+}
+
+void MethodCache::store(const std::string& key, llvm::StringRef object) const
+{
+  // The object is written to a temporary file which is then renamed, which is
+  // atomic, so other compilers sharing the cache never see half an object.
+  auto final_path = path(key);
+  llvm::SmallString<128> temporary_path;
+  int file_descriptor;
+  if (auto error_code = llvm::sys::fs::createUniqueFile(
+    final_path + ".%%%%%%.tmp", file_descriptor, temporary_path))
+    throw make_error<GeneralError>("unable to create file in the method "
+      "cache: ", error_code.message());
+  {
+    llvm::raw_fd_ostream stream{file_descriptor, true};
+    stream << object;
+    stream.close();
+    if (stream.has_error()) {
+      llvm::sys::fs::remove(temporary_path);
+      throw make_error<GeneralError>("unable to write to the method cache: ",
+        stream.error().message());
+    }
+  }
+  if (auto error_code = llvm::sys::fs::rename(temporary_path, final_path)) {
+    llvm::sys::fs::remove(temporary_path);
+    throw make_error<GeneralError>("unable to write to the method cache: ",
+      error_code.message());
+  }
+}
+
+std::string MethodCache::path(const std::string& key) const
+{
+  llvm::SmallString<128> path{m_directory};
+  llvm::sys::path::append(path, key + ".o");
+  return path.str().str();
+}
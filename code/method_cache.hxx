@@ -0,0 +1,62 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_METHOD_CACHE_HXX
+#define BUCKET_METHOD_CACHE_HXX
+
+#include "abstract_syntax_tree.hxx"
+#include "optimization_level.hxx"
+#include "target.hxx"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <string>
+#include <string_view>
+
+class MethodCache {
+// A directory holding the object code of single methods, so that a rebuild
+// only has to compile the methods which changed. Every object file is named
+// after a key which hashes everything its code depends on: the abstract
+// syntax tree of the method, the part of the program's interface it refers to
+// (the signatures of the methods it may call and the layouts of the classes
+// it may use, see CodeGenerator::describeReferences()), the optimization
+// level, the target processor and the compiler itself (its executable and the
+// llvm version). Since calls are only resolved while the code is generated,
+// every method which has the name of one the code calls counts as referred
+// to, so changing a method invalidates the callers of every method of that
+// name. Objects are written atomically, so several compiler processes can
+// share a cache directory.
+
+public:
+
+  MethodCache(std::string directory, OptimizationLevel level,
+    const Target& target);
+  // Creates the directory if it doesn't exist yet.
+
+  std::string key(std::string_view path, ast::Method& ast_method,
+    std::string_view references) const;
+  // Computes the key of a method from its symbol table path, its syntax tree
+  // and a description of the classes and methods of the program it refers to.
+
+  bool contains(const std::string& key) const;
+  llvm::SmallString<0> load(const std::string& key) const;
+  void store(const std::string& key, llvm::StringRef object) const;
+
+private:
+
+  std::string m_directory;
+  std::string m_compiler;
+
+  std::string path(const std::string& key) const;
+
+};
+
+#endif
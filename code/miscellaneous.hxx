@@ -14,6 +14,7 @@
 #define BUCKET_MISCELLANEOUS_HXX
 
 #include <algorithm>
+#include <atomic>
 #ifdef BUCKET_USE_ALLOCA
 #include <alloca.h>
 #endif
@@ -23,12 +24,15 @@
 #endif
 #include <cassert>
 #include <cstddef>
+#include <exception>
 #include <functional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #if defined(__clang__)
   #if __has_feature(cxx_rtti)
@@ -118,6 +122,14 @@ public:
   std::string_view errorName() override {return "Code Generator Error";}
 };
 
+class InterfaceError : public CompilerError {
+public:
+  explicit InterfaceError(const char* msg)
+  : CompilerError(msg)
+  {}
+  std::string_view errorName() override {return "Interface Error";}
+};
+
 namespace details {
 
 // There is no template in type_traits to determine if a type is an integer, so
@@ -558,4 +570,35 @@ std::string concatenate(Args&&... args) {
   );
 }
 
+template <typename Function>
+void parallelFor(std::size_t count, unsigned jobs, Function function)
+// Calls function(index) for every index below count on up to jobs threads, but
+// never on more threads than the processor can run at once. Exceptions are
+// rethrown once all threads are done.
+{
+  std::vector<std::exception_ptr> errors(count);
+  std::atomic<std::size_t> next_index{0};
+  auto work = [&] {
+    for (std::size_t index; (index = next_index++) < count;) {
+      try {
+        function(index);
+      }
+      catch (...) {
+        errors[index] = std::current_exception();
+      }
+    }
+  };
+  auto thread_count = std::min<std::size_t>({jobs, count,
+    std::max(std::thread::hardware_concurrency(), 1u)});
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < thread_count; ++i)
+    threads.emplace_back(work);
+  work();
+  for (auto& thread : threads)
+    thread.join();
+  for (auto& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
 #endif
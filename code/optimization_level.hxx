@@ -0,0 +1,37 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_OPTIMIZATION_LEVEL_HXX
+#define BUCKET_OPTIMIZATION_LEVEL_HXX
+
+#include <optional>
+#include <string_view>
+
+enum class OptimizationLevel {
+  O0, O1, O2, O3, Os
+};
+
+inline std::optional<OptimizationLevel> string2OptimizationLevel(
+  std::string_view string)
+// Converts the argument of the -O option to an optimization level (e.g. "2"
+// becomes OptimizationLevel::O2). If the string is not an optimization level,
+// a null optional is returned.
+{
+  if (string == "0") return OptimizationLevel::O0;
+  if (string == "1") return OptimizationLevel::O1;
+  if (string == "2") return OptimizationLevel::O2;
+  if (string == "3") return OptimizationLevel::O3;
+  if (string == "s") return OptimizationLevel::Os;
+  return std::nullopt;
+}
+
+#endif
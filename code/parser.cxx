@@ -12,6 +12,11 @@
 
 #include "parser.hxx"
 #include "miscellaneous.hxx"
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <string_view>
 
 #define STRINGIZE(x) STRINGIZE2(x)
 #define STRINGIZE2(x) #x
@@ -51,6 +56,7 @@ std::unique_ptr<ast::Global> Parser::parseGlobal()
 {
   if (std::unique_ptr<ast::Global> global_ptr;
     (global_ptr = parseClass())  ||
+    (global_ptr = parseDecoratedMethod()) ||
     (global_ptr = parseMethod()) ||
     (global_ptr = parseField()))
     return global_ptr;
@@ -71,6 +77,85 @@ std::unique_ptr<ast::Class> Parser::parseClass()
   return class_ptr;
 }
 
+std::unique_ptr<ast::Method> Parser::parseDecoratedMethod()
+{
+  auto decorators = parseMethodDecorators();
+  if (decorators.empty())
+    return nullptr;
+  auto method_ptr = parseMethod();
+  if (!method_ptr)
+    throw make_error<ParserError>("method decorators must be followed by a "
+      "method:\n", m_lexer.highlight(*m_token_iter));
+  method_ptr->decorators = std::move(decorators);
+  return method_ptr;
+}
+
+std::vector<InternedString> Parser::parseMethodDecorators()
+{
+  auto annotations = parseAnnotations("method decorator",
+    {"inline", "noinline", "hot", "cold", "pure", "leaf"},
+    [](const ast::Annotation& annotation,
+      const std::vector<ast::Annotation>& previous) -> const char* {
+      if (annotation.argument)
+        return "method decorators take no argument";
+      // pairs of decorators which contradict each other
+      auto name = annotation.name.view();
+      for (auto& other : previous) {
+        auto other_name = other.name.view();
+        if ((other_name == "inline" && name == "noinline")
+          || (other_name == "noinline" && name == "inline")
+          || (other_name == "hot" && name == "cold")
+          || (other_name == "cold" && name == "hot"))
+          return "conflicting method decorators";
+      }
+      return nullptr;
+    });
+  std::vector<InternedString> result;
+  for (auto& annotation : annotations)
+    result.push_back(annotation.name);
+  return result;
+}
+
+std::vector<ast::Annotation> Parser::parseAnnotations(
+  std::string_view kind, std::initializer_list<std::string_view> names,
+  const char* (*check)(const ast::Annotation&,
+    const std::vector<ast::Annotation>&))
+{
+  std::vector<ast::Annotation> result;
+  while (accept(Symbol::AtSymbol)) {
+    auto token = *m_token_iter;
+    ast::Annotation annotation;
+    annotation.name = expectIdentifier();
+    if (accept(Symbol::OpenParenthesis)) {
+      auto argument_token = *m_token_iter;
+      auto argument = parseIntegerLiteral();
+      if (!argument || argument->value < 1
+        || argument->value > std::numeric_limits<std::int32_t>::max())
+        throw make_error<ParserError>("the argument of a ", kind, " must be a "
+          "positive integer:\n", m_lexer.highlight(argument_token));
+      annotation.argument = argument->value;
+      expect(Symbol::CloseParenthesis);
+    }
+
+    auto name = annotation.name.view();
+    if (std::find(names.begin(), names.end(), name) == names.end())
+      throw make_error<ParserError>("unknown ", kind, " '@", name, "':\n",
+        m_lexer.highlight(token));
+    for (auto& other : result)
+      if (other.name == annotation.name)
+        throw make_error<ParserError>("conflicting ", kind, "s:\n",
+          m_lexer.highlight(token));
+    if (auto message = check(annotation, result))
+      throw make_error<ParserError>(message, ":\n", m_lexer.highlight(token));
+    result.push_back(annotation);
+
+    // annotations can be on lines of their own
+    while (accept(Symbol::Newline))
+      ;
+  }
+  return result;
+}
+
 std::unique_ptr<ast::Method> Parser::parseMethod()
 {
   if (!accept(Keyword::Method))
@@ -148,6 +233,7 @@ std::unique_ptr<ast::Statement> Parser::parseStatement()
   if (std::unique_ptr<ast::Statement> statement_ptr;
     (statement_ptr = parseDeclaration()) ||
     (statement_ptr = parseIf()) ||
+    (statement_ptr = parseAnnotatedLoop()) ||
     (statement_ptr = parseInfiniteLoop()) ||
     (statement_ptr = parsePreTestLoop()) ||
     (statement_ptr = parseBreak()) ||
@@ -201,6 +287,42 @@ std::unique_ptr<ast::If> Parser::parseIf()
   return if_ptr;
 }
 
+std::unique_ptr<ast::Statement> Parser::parseAnnotatedLoop()
+{
+  auto annotations = parseLoopAnnotations();
+  if (annotations.empty())
+    return nullptr;
+  if (auto infinite_loop_ptr = parseInfiniteLoop()) {
+    infinite_loop_ptr->annotations = std::move(annotations);
+    return infinite_loop_ptr;
+  }
+  if (auto pre_test_loop_ptr = parsePreTestLoop()) {
+    pre_test_loop_ptr->annotations = std::move(annotations);
+    return pre_test_loop_ptr;
+  }
+  throw make_error<ParserError>("loop annotations must be followed by a loop:"
+    "\n", m_lexer.highlight(*m_token_iter));
+}
+
+std::vector<ast::Annotation> Parser::parseLoopAnnotations()
+{
+  return parseAnnotations("loop annotation",
+    {"unroll", "nounroll", "vectorize", "interleave"},
+    [](const ast::Annotation& annotation,
+      const std::vector<ast::Annotation>& previous) -> const char* {
+      auto name = annotation.name.view();
+      if (name == "nounroll" && annotation.argument)
+        return "'@nounroll' takes no argument";
+      if (name == "interleave" && !annotation.argument)
+        return "'@interleave' needs the number of iterations to interleave";
+      for (auto& other : previous)
+        if (other.name.view().find("unroll") != std::string_view::npos
+          && name.find("unroll") != std::string_view::npos)
+          return "conflicting loop annotations";
+      return nullptr;
+    });
+}
+
 std::unique_ptr<ast::InfiniteLoop> Parser::parseInfiniteLoop()
 {
   if (!accept(Keyword::Do))
@@ -324,7 +446,7 @@ std::unique_ptr<ast::Expression> Parser::parseAndExpression()
 std::unique_ptr<ast::Expression> Parser::parseEqualityExpression()
 {
   if (auto comparison_expression = parseComparisonExpression()) {
-    std::string name;
+    InternedString name;
     if (accept(Symbol::ExclamationPointEquals)) {
       name = "__neq__";
     }
@@ -349,7 +471,7 @@ std::unique_ptr<ast::Expression> Parser::parseEqualityExpression()
 std::unique_ptr<ast::Expression> Parser::parseComparisonExpression()
 {
   if (auto arithmetic_expression = parseArithmeticExpression()) {
-    std::string name;
+    InternedString name;
     if (accept(Symbol::Greater)) {
       name = "__gt__";
     }
@@ -382,7 +504,7 @@ std::unique_ptr<ast::Expression> Parser::parseArithmeticExpression()
   auto expression = parseTerm();
   if (!expression)
     return nullptr;
-  std::string name;
+  InternedString name;
   if (accept(Symbol::Plus))
     name = "__add__";
   else if (accept(Symbol::Minus))
@@ -419,7 +541,7 @@ std::unique_ptr<ast::Expression> Parser::parseTerm()
   auto expression = parseFactor();
   if (!expression)
     return nullptr;
-  std::string name;
+  InternedString name;
   if (accept(Symbol::Asterisk))
     name = "__mul__";
   else if (accept(Symbol::Slash))
@@ -459,7 +581,7 @@ std::unique_ptr<ast::Expression> Parser::parseFactor()
 {
   if (auto exponent = parseExponent())
     return exponent;
-  std::string name;
+  InternedString name;
   if (accept(Symbol::Plus)) {
     name = "__pos__";
   }
@@ -704,7 +826,7 @@ void Parser::expect(Symbol symbol)
       "':\n", m_lexer.highlight(*m_token_iter));
 }
 
-std::optional<std::string> Parser::acceptIdentifier()
+std::optional<InternedString> Parser::acceptIdentifier()
 {
   if (auto string = m_token_iter->getIdentifier()) {
     ++m_token_iter;
@@ -713,7 +835,7 @@ std::optional<std::string> Parser::acceptIdentifier()
   return std::nullopt;
 }
 
-std::string Parser::expectIdentifier()
+InternedString Parser::expectIdentifier()
 {
   if (auto string = acceptIdentifier())
     return *string;
@@ -16,9 +16,11 @@
 #include "abstract_syntax_tree.hxx"
 #include "lexer.hxx"
 #include <boost/noncopyable.hpp>
+#include <initializer_list>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Parser : private boost::noncopyable {
@@ -34,12 +36,20 @@ private:
   std::vector<std::unique_ptr<ast::Global>> parseGlobals();
   std::unique_ptr<ast::Global> parseGlobal();
   std::unique_ptr<ast::Class> parseClass();
+  std::unique_ptr<ast::Method> parseDecoratedMethod();
+  std::vector<InternedString> parseMethodDecorators();
+  std::vector<ast::Annotation> parseAnnotations(std::string_view kind,
+    std::initializer_list<std::string_view> names,
+    const char* (*check)(const ast::Annotation&,
+      const std::vector<ast::Annotation>&));
   std::unique_ptr<ast::Method> parseMethod();
   std::unique_ptr<ast::Field> parseField();
   std::vector<std::unique_ptr<ast::Statement>> parseStatements();
   std::unique_ptr<ast::Statement> parseStatement();
   std::unique_ptr<ast::Declaration> parseDeclaration();
   std::unique_ptr<ast::If> parseIf();
+  std::unique_ptr<ast::Statement> parseAnnotatedLoop();
+  std::vector<ast::Annotation> parseLoopAnnotations();
   std::unique_ptr<ast::InfiniteLoop> parseInfiniteLoop();
   std::unique_ptr<ast::PreTestLoop> parsePreTestLoop();
   std::unique_ptr<ast::Break> parseBreak();
@@ -66,10 +76,10 @@ private:
 
   bool accept(Keyword);
   bool accept(Symbol);
-  std::optional<std::string> acceptIdentifier();
+  std::optional<InternedString> acceptIdentifier();
   void expect(Keyword);
   void expect(Symbol);
-  std::string expectIdentifier();
+  InternedString expectIdentifier();
 
   Lexer& m_lexer;
   Lexer::iterator m_token_iter;
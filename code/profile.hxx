@@ -0,0 +1,33 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_PROFILE_HXX
+#define BUCKET_PROFILE_HXX
+
+#include <string>
+
+struct Profile {
+// How the generated code is profiled (see the --profile-generate and
+// --profile-use options). Generated code can either be instrumented to count
+// how often each of its edges is taken, in which case the program writes the
+// counts to a raw profile at path when it exits, or be optimized with the
+// counts of an indexed profile at path (made from raw profiles by
+// llvm-profdata merge).
+
+  enum class Mode {None, Generate, Use};
+
+  Mode mode = Mode::None;
+  std::string path;
+
+};
+
+#endif
@@ -0,0 +1,162 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// The part of the runtime which writes the counters of programs compiled with
+// --profile-generate to a raw profile, in the format llvm-profdata reads. This
+// is a small subset of compiler-rt's profile runtime: the profile is written
+// once when the program exits, without merging into an existing file and
+// without value profiles (bucket has no indirect calls whose targets could be
+// profiled).
+//
+// It is a member of libbuiltin.a on its own, which is only linked into
+// instrumented programs: those reference __llvm_profile_runtime (see
+// CodeGenerator::optimize()).
+//
+// The instrumented code puts the per-method records, the counters and the
+// names of the methods into sections of their own, whose bounds the linker
+// provides as __start_ and __stop_ symbols. The layout of the records and of
+// the header of the file come from llvm's InstrProfData.inc, so they match the
+// llvm the compiler was built with.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+// without any of the macros defined, for the names and constants
+#include <llvm/ProfileData/InstrProfData.inc>
+
+namespace {
+
+using IntPtrT = void*;
+
+enum ValueKind {
+  #define VALUE_PROF_KIND(Enumerator, Value, Descr) Enumerator = Value,
+  #include <llvm/ProfileData/InstrProfData.inc>
+};
+
+struct ProfileData {
+  #define INSTR_PROF_DATA(Type, LLVMType, Name, Initializer) Type Name;
+  #include <llvm/ProfileData/InstrProfData.inc>
+};
+
+struct ProfileHeader {
+  #define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) Type Name;
+  #include <llvm/ProfileData/InstrProfData.inc>
+};
+
+}
+
+extern "C" {
+
+#define START(section) INSTR_PROF_SECT_START(section)
+#define STOP(section) INSTR_PROF_SECT_STOP(section)
+
+// weak, so that a program without any instrumented code still links
+extern const char START(INSTR_PROF_DATA_COMMON)[]
+  __attribute__((weak, visibility("hidden")));
+extern const char STOP(INSTR_PROF_DATA_COMMON)[]
+  __attribute__((weak, visibility("hidden")));
+extern const char START(INSTR_PROF_CNTS_COMMON)[]
+  __attribute__((weak, visibility("hidden")));
+extern const char STOP(INSTR_PROF_CNTS_COMMON)[]
+  __attribute__((weak, visibility("hidden")));
+extern const char START(INSTR_PROF_NAME_COMMON)[]
+  __attribute__((weak, visibility("hidden")));
+extern const char STOP(INSTR_PROF_NAME_COMMON)[]
+  __attribute__((weak, visibility("hidden")));
+
+// defined by the instrumented code: the version of the profile (with the
+// variant bits of IR instrumentation) and the path given to --profile-generate
+extern const std::uint64_t INSTR_PROF_RAW_VERSION_VAR __attribute__((weak));
+extern const char INSTR_PROF_PROFILE_NAME_VAR[] __attribute__((weak));
+
+int INSTR_PROF_PROFILE_RUNTIME_VAR;
+
+}
+
+namespace {
+
+// used by the initializers of the header in InstrProfData.inc
+std::uint64_t __llvm_profile_get_magic()
+{
+  return sizeof(void*) == 8 ? (INSTR_PROF_RAW_MAGIC_64)
+    : (INSTR_PROF_RAW_MAGIC_32);
+}
+
+std::uint64_t __llvm_profile_get_version()
+{
+  return &INSTR_PROF_RAW_VERSION_VAR ? INSTR_PROF_RAW_VERSION_VAR
+    : INSTR_PROF_RAW_VERSION;
+}
+
+[[maybe_unused]] std::uint64_t __llvm_write_binary_ids(void*)
+{
+  return 0;
+}
+
+// The file is named by the environment variable LLVM_PROFILE_FILE, the path
+// given to --profile-generate or default.profraw, in that order.
+const char* profilePath()
+{
+  if (auto path = std::getenv("LLVM_PROFILE_FILE"); path && *path)
+    return path;
+  if (INSTR_PROF_PROFILE_NAME_VAR && *INSTR_PROF_PROFILE_NAME_VAR)
+    return INSTR_PROF_PROFILE_NAME_VAR;
+  return "default.profraw";
+}
+
+void writeProfile()
+{
+  auto DataBegin = START(INSTR_PROF_DATA_COMMON);
+  auto CountersBegin = START(INSTR_PROF_CNTS_COMMON);
+  auto NamesBegin = START(INSTR_PROF_NAME_COMMON);
+  if (!DataBegin)
+    return;
+  std::uint64_t DataSize = static_cast<std::uint64_t>(
+    STOP(INSTR_PROF_DATA_COMMON) - DataBegin) / sizeof(ProfileData);
+  std::uint64_t CountersSize = static_cast<std::uint64_t>(
+    STOP(INSTR_PROF_CNTS_COMMON) - CountersBegin) / sizeof(std::uint64_t);
+  std::uint64_t NamesSize = static_cast<std::uint64_t>(
+    STOP(INSTR_PROF_NAME_COMMON) - NamesBegin);
+  // the counters follow the records directly (both are multiples of 8 bytes
+  // long), only the names are padded to a multiple of 8 bytes
+  [[maybe_unused]] std::uint64_t PaddingBytesBeforeCounters = 0;
+  [[maybe_unused]] std::uint64_t PaddingBytesAfterCounters = 0;
+  std::uint64_t PaddingBytesAfterNames = -NamesSize % 8;
+
+  ProfileHeader header = {
+    #define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) Initializer,
+    #include <llvm/ProfileData/InstrProfData.inc>
+  };
+  static const char padding[8] = {};
+
+  auto path = profilePath();
+  auto file = std::fopen(path, "wb");
+  if (!file) {
+    std::fprintf(stderr, "unable to write the profile '%s'\n", path);
+    return;
+  }
+  bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+    && std::fwrite(DataBegin, sizeof(ProfileData), DataSize, file) == DataSize
+    && std::fwrite(CountersBegin, sizeof(std::uint64_t), CountersSize, file)
+      == CountersSize
+    && std::fwrite(NamesBegin, 1, NamesSize, file) == NamesSize
+    && std::fwrite(padding, 1, PaddingBytesAfterNames, file)
+      == PaddingBytesAfterNames;
+  if (std::fclose(file) != 0 || !written)
+    std::fprintf(stderr, "unable to write the profile '%s'\n", path);
+}
+
+// registered when the program starts, so that the profile is written by
+// exit() or when main returns
+[[maybe_unused]] const bool registered = std::atexit(writeProfile) == 0;
+
+}
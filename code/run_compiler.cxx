@@ -1,20 +1,55 @@
 #include "run_compiler.hxx"
+#include "artifact_cache.hxx"
 #include "lexer.hxx"
+#include "linker.hxx"
 #include "source_file.hxx"
 #include "abstract_syntax_tree.hxx"
 #include "code_generator.hxx"
+#include "constant_folder.hxx"
+#include "jit.hxx"
+#include "method_cache.hxx"
 #include "miscellaneous.hxx"
 #include "parser.hxx"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <optional>
 #include <string>
+#include <thread>
 #include <utf8cpp/utf8.h>
+#include <vector>
 
-void run_compiler(
+namespace {
+
+std::size_t countMethods(ast::Node* ast_node)
+{
+  if (ast::ast_cast<ast::Method*>(ast_node))
+    return 1;
+  std::size_t count = 0;
+  if (auto ast_program = ast::ast_cast<ast::Program*>(ast_node))
+    for (auto& ast_global : ast_program->globals)
+      count += countMethods(ast_global.get());
+  if (auto ast_class = ast::ast_cast<ast::Class*>(ast_node))
+    for (auto& ast_global : ast_class->globals)
+      count += countMethods(ast_global.get());
+  return count;
+}
+
+}
+
+int run_compiler(
   std::string input_path,
   std::optional<std::string> output_path_optional,
+  std::vector<std::string> import_paths,
+  std::optional<std::string> interface_path_optional,
+  OptimizationLevel optimization_level,
+  Target target,
+  Profile profile,
+  unsigned jobs,
+  std::optional<std::string> method_cache_path_optional,
+  std::optional<std::string> cache_path_optional,
   bool read,
   bool lex,
   bool parse,
@@ -22,11 +57,62 @@ void run_compiler(
   bool bc,
   bool asmb,
   bool obj,
-  bool exec
+  bool exec,
+  bool run
 )
 {
-  if (!(read || lex || parse || ir || bc || asmb || obj || exec))
+  if (!(read || lex || parse || ir || bc || asmb || obj || exec || run
+    || interface_path_optional))
     exec = true;
+  bool interface = static_cast<bool>(interface_path_optional);
+
+  // Profiles are only generated and used by the optimization pipeline, which
+  // the method cache runs for every method on its own (so the profile of a
+  // method which wasn't recompiled would go stale).
+  if (profile.mode != Profile::Mode::None) {
+    if (optimization_level == OptimizationLevel::O0)
+      throw make_error<GeneralError>("profiles are only generated and used "
+        "when optimizing (-O1 and above)");
+    if (method_cache_path_optional)
+      throw make_error<GeneralError>("profiles can't be generated or used "
+        "with --method-cache");
+    if (profile.mode == Profile::Mode::Generate && run)
+      throw make_error<GeneralError>("--profile-generate only works for "
+        "programs which are linked with the runtime, not with --run");
+  }
+
+  // Compilations producing a single file can be served from the cache. On a
+  // miss the entry stays locked until the output has been stored.
+  std::optional<ArtifactCache> cache;
+  std::optional<ArtifactCache::Entry> cache_entry;
+  std::string cache_output_path = output_path_optional ? *output_path_optional
+    : std::string("a.out");
+  if (cache_path_optional && !(read || lex || parse || run || interface)
+    && ir + bc + asmb + obj + exec == 1 && (output_path_optional || exec)) {
+    std::string flags = std::string(ir ? "ir" : bc ? "bc" : asmb ? "asm"
+      : obj ? "obj" : "exec") + " -O" + std::to_string(static_cast<int>(
+      optimization_level)) + ' ' + target2String(target)
+      + (method_cache_path_optional ? " method-cache" : "");
+    // the contents of a profile which is used and of the files linked into
+    // executables are hashed with the inputs
+    auto dependency_paths = import_paths;
+    if (exec) {
+      auto linked_files = linkedFiles();
+      dependency_paths.insert(dependency_paths.end(), linked_files.begin(),
+        linked_files.end());
+    }
+    if (profile.mode == Profile::Mode::Generate)
+      flags += " profile-generate=" + profile.path;
+    else if (profile.mode == Profile::Mode::Use) {
+      flags += " profile-use";
+      dependency_paths.push_back(profile.path);
+    }
+    cache.emplace(*cache_path_optional);
+    cache_entry.emplace(*cache, cache->key(input_path, dependency_paths,
+      flags));
+    if (cache_entry->fetch(cache_output_path))
+      return 0;
+  }
 
   std::ofstream output_file_stream;
   output_file_stream.exceptions(std::ios_base::badbit | std::ios_base::failbit);
@@ -52,8 +138,8 @@ void run_compiler(
     }
   }
 
-  if (!(lex || parse || ir || bc || asmb || obj || exec))
-    return;
+  if (!(lex || parse || ir || bc || asmb || obj || exec || run || interface))
+    return 0;
 
   Lexer lexer{source_file};
 
@@ -61,8 +147,8 @@ void run_compiler(
     for (auto token : lexer)
       *output_stream_ptr << token;
 
-  if (!(parse || ir || bc || asmb || obj || exec))
-    return;
+  if (!(parse || ir || bc || asmb || obj || exec || run || interface))
+    return 0;
 
   Parser parser{lexer};
   auto ast_program = parser.parse();
@@ -70,23 +156,89 @@ void run_compiler(
   if (parse)
     *output_stream_ptr << *ast_program;
 
-  if (!(ir || bc || asmb || obj || exec))
-    return;
+  if (!(ir || bc || asmb || obj || exec || run || interface))
+    return 0;
 
-  CodeGenerator code_generator{};
-  ast::dispatch(ast_program.get(), &code_generator);
+  foldConstants(ast_program.get());
 
-  if (ir)
-    code_generator.printIR(output_path_optional);
+  // With a method cache only the methods which changed are generated and every
+  // method is compiled on its own, so the program never exists as a whole.
+  std::optional<MethodCache> method_cache;
+  if (method_cache_path_optional) {
+    if (ir || bc || asmb || run || (obj && !output_path_optional))
+      throw make_error<GeneralError>("--method-cache only works when writing "
+        "object files or executables to a file");
+    method_cache.emplace(*method_cache_path_optional, optimization_level,
+      target);
+  }
+
+  // Generate the code in shards, then link the shards together. How the
+  // methods are split only depends on the program: every shard declares the
+  // whole program, so it gets at least methods_per_shard methods and small
+  // programs aren't split at all. Since the split doesn't depend on jobs,
+  // neither does the linked module (see CodeGenerator::linkShard() for how it
+  // differs from an unsplit one). The shards are generated on up to jobs
+  // threads (the AST is only read) and the linked module is optimized as a
+  // whole (which also lets methods be inlined across shards).
+  constexpr std::size_t methods_per_shard = 64;
+  constexpr std::size_t max_shards = 16;
+  if (jobs == 0)
+    jobs = std::max(std::thread::hardware_concurrency(), 1u);
+  auto shard_count = std::clamp<std::size_t>(
+    countMethods(ast_program.get()) / methods_per_shard, 1, max_shards);
+  std::vector<std::unique_ptr<CodeGenerator>> code_generators(shard_count);
+  parallelFor(shard_count, jobs, [&](std::size_t shard) {
+    auto code_generator = std::make_unique<CodeGenerator>(shard, shard_count,
+      target);
+    for (auto& import_path : import_paths)
+      code_generator->importInterface(import_path);
+    if (method_cache)
+      code_generator->useMethodCache(*method_cache);
+    ast::dispatch(ast_program.get(), code_generator.get());
+    if (interface && shard == 0)
+      code_generator->exportInterface(*interface_path_optional);
+    code_generators[shard] = std::move(code_generator);
+  });
+  auto& code_generator = *code_generators[0];
+  for (std::size_t shard = 1; shard < shard_count; ++shard)
+    code_generator.linkShard(*code_generators[shard]);
+  code_generators.resize(1);
+
+  if (method_cache) {
+    auto objects = code_generator.compileMethods(optimization_level, jobs);
+    if (obj)
+      linkObject(objects, *output_path_optional);
+    if (exec)
+      linkExecutable(objects, output_path_optional ? *output_path_optional
+        : std::string("a.out"));
+  }
+  else {
+    code_generator.optimize(optimization_level, profile);
+
+    if (ir)
+      code_generator.printIR(output_path_optional);
 
-  if (!(bc || asmb || obj || exec))
-    return;
+    if (bc)
+      code_generator.printBC(output_path_optional);
 
-  if (bc)
-    code_generator.printBC(output_path_optional);
+    if (asmb)
+      code_generator.printAssembly(output_path_optional);
+
+    if (obj)
+      linkObject(code_generator, output_path_optional, jobs);
+
+    if (exec)
+      linkExecutable(code_generator, output_path_optional
+        ? *output_path_optional : std::string("a.out"), jobs);
+  }
+
+  if (cache_entry) {
+    output_file_stream.close();
+    cache_entry->store(cache_output_path);
+  }
 
-  if (!(asmb || obj || exec))
-    return;
+  if (run)
+    return runProgram(code_generator);
 
-  throw make_error<GeneralError>("use llc/lld to create object files and executables");
+  return 0;
 }
@@ -1,12 +1,24 @@
 #ifndef BUCKET_RUN_COMPILER_HXX
 #define BUCKET_RUN_COMPILER_HXX
 
+#include "optimization_level.hxx"
+#include "profile.hxx"
+#include "target.hxx"
 #include <optional>
 #include <string>
+#include <vector>
 
-void run_compiler(
+int run_compiler(
   std::string input_path,
   std::optional<std::string> output_path_optional,
+  std::vector<std::string> import_paths,
+  std::optional<std::string> interface_path_optional,
+  OptimizationLevel optimization_level,
+  Target target,
+  Profile profile,
+  unsigned jobs,
+  std::optional<std::string> method_cache_path_optional,
+  std::optional<std::string> cache_path_optional,
   bool read,
   bool lex,
   bool parse,
@@ -14,7 +26,8 @@ void run_compiler(
   bool bc,
   bool asmb,
   bool obj,
-  bool exec
+  bool exec,
+  bool run
 );
 
 #endif
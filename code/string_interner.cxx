@@ -0,0 +1,143 @@
+// Copyright (C) 2019  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "string_interner.hxx"
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class StringInterner : private boost::noncopyable {
+// The table behind InternedString. The table is split into shards (chosen by
+// the hash of the string) which each have their own lock, so that threads
+// interning different strings rarely wait on each other.
+
+public:
+
+  static StringInterner& get();
+
+  const InternedString::Data* intern(std::string_view string);
+
+private:
+
+  StringInterner() = default;
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string_view, const InternedString::Data*> map;
+    std::deque<InternedString::Data> data;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* cursor = nullptr;
+    std::size_t remaining = 0;
+  };
+
+  static constexpr std::size_t shard_count = 16;
+  static constexpr std::size_t chunk_size = 4096;
+
+  Shard m_shards[shard_count];
+
+};
+
+StringInterner& StringInterner::get()
+{
+  static StringInterner interner;
+  return interner;
+}
+
+const InternedString::Data* StringInterner::intern(std::string_view string)
+{
+  if (string.empty())
+    return nullptr;
+  auto hash = std::hash<std::string_view>{}(string);
+  auto& shard = m_shards[hash % shard_count];
+  std::lock_guard<std::mutex> lock{shard.mutex};
+  auto iter = shard.map.find(string);
+  if (iter != shard.map.end())
+    return iter->second;
+  char* storage;
+  if (string.size() > chunk_size / 4) {
+    // big strings get a chunk of their own so that the current chunk isn't
+    // abandoned half full
+    shard.chunks.push_back(std::make_unique<char[]>(string.size()));
+    storage = shard.chunks.back().get();
+  }
+  else {
+    if (shard.remaining < string.size()) {
+      shard.chunks.push_back(std::make_unique<char[]>(chunk_size));
+      shard.cursor = shard.chunks.back().get();
+      shard.remaining = chunk_size;
+    }
+    storage = shard.cursor;
+    shard.cursor += string.size();
+    shard.remaining -= string.size();
+  }
+  std::copy(string.begin(), string.end(), storage);
+  auto& data = shard.data.emplace_back(InternedString::Data{hash,
+    std::string_view(storage, string.size())});
+  shard.map.emplace(data.string, &data);
+  return &data;
+}
+
+InternedString::InternedString() noexcept
+: m_data{nullptr}
+{}
+
+InternedString::InternedString(std::string_view string)
+: m_data{StringInterner::get().intern(string)}
+{}
+
+InternedString::InternedString(const char* string)
+: InternedString(std::string_view(string))
+{}
+
+InternedString::InternedString(const std::string& string)
+: InternedString(std::string_view(string))
+{}
+
+std::string_view InternedString::view() const noexcept
+{
+  return m_data ? m_data->string : std::string_view();
+}
+
+InternedString::operator std::string_view() const noexcept
+{
+  return view();
+}
+
+const char* InternedString::data() const noexcept
+{
+  return view().data();
+}
+
+std::size_t InternedString::size() const noexcept
+{
+  return view().size();
+}
+
+bool InternedString::empty() const noexcept
+{
+  return !m_data;
+}
+
+std::size_t InternedString::hash() const noexcept
+{
+  return m_data ? m_data->hash : 0;
+}
+
+std::ostream& operator<<(std::ostream& stream, InternedString string)
+{
+  return stream << string.view();
+}
@@ -0,0 +1,113 @@
+// Copyright (C) 2019  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_STRING_INTERNER_HXX
+#define BUCKET_STRING_INTERNER_HXX
+
+#include "miscellaneous.hxx"
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+class InternedString {
+// A handle to a string stored in a process wide (and thread safe) table of
+// strings. Every distinct string is stored exactly once, so two handles are
+// equal if and only if they point to the same entry, which makes comparing
+// them a single pointer comparison. The hash of the string is computed once
+// when the string is first interned. Interned strings are never freed, so a
+// handle stays valid for the rest of the program. Identifiers are interned by
+// the lexer and passed as handles through the parser and the AST.
+
+public:
+
+  InternedString() noexcept;
+  // Constructs a handle to the empty string (this doesn't touch the table)
+
+  InternedString(std::string_view string);
+  InternedString(const char* string);
+  InternedString(const std::string& string);
+  // Interns a string. These are implicit so that an InternedString can be
+  // assigned from a string literal just like a std::string can.
+
+  std::string_view view() const noexcept;
+  operator std::string_view() const noexcept;
+  const char* data() const noexcept;
+  std::size_t size() const noexcept;
+  bool empty() const noexcept;
+  // Access the interned string. The string is not null terminated.
+
+  std::size_t hash() const noexcept;
+  // Returns the hash of the string, which was computed when it was interned
+
+  friend bool operator==(InternedString lhs, InternedString rhs) noexcept
+  {
+    return lhs.m_data == rhs.m_data;
+  }
+  friend bool operator!=(InternedString lhs, InternedString rhs) noexcept
+  {
+    return lhs.m_data != rhs.m_data;
+  }
+
+private:
+
+  friend class StringInterner;
+
+  struct Data {
+    std::size_t hash;
+    std::string_view string;
+  };
+
+  const Data* m_data;
+  // nullptr for the empty string
+
+};
+
+std::ostream& operator<<(std::ostream& stream, InternedString string);
+
+namespace std {
+
+template <>
+struct hash<InternedString>
+{
+  std::size_t operator()(InternedString string) const noexcept
+  {
+    return string.hash();
+  }
+};
+
+}
+
+namespace details {
+
+template <>
+struct TypeConverter<InternedString>
+{
+  using type = std::string_view;
+};
+
+template <>
+struct TypeConverter<InternedString&>
+{
+  using type = std::string_view;
+};
+
+template <>
+struct TypeConverter<const InternedString&>
+{
+  using type = std::string_view;
+};
+
+}
+
+#endif
@@ -14,37 +14,88 @@
 #include "abstract_syntax_tree.hxx"
 #include "miscellaneous.hxx"
 #include <algorithm>
-#include <boost/algorithm/string/predicate.hpp>
+#include <boost/container/small_vector.hpp>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Type.h>
+#include <new>
 #include <utility>
 #ifdef BUCKET_DEBUG
 #include <iostream>
 #endif
 
 SymbolTable::SymbolTable()
-: m_scope{'/'}
+: m_node_recycler{},
+  m_pools{},
+  m_paths{},
+  m_scoped_paths{},
+  m_unnamed_scopes{},
+  m_scoped_entries{},
+  m_map{Map::allocator_type{&m_node_recycler}},
+  m_scope{'/'},
+  m_parent{nullptr},
+  m_frozen{false}
 {}
 
+SymbolTable::SymbolTable(SymbolTable* parent, std::string_view scope)
+: m_node_recycler{},
+  m_pools{},
+  m_paths{},
+  m_scoped_paths{},
+  m_unnamed_scopes{},
+  m_scoped_entries{},
+  m_map{Map::allocator_type{&m_node_recycler}},
+  m_scope{scope},
+  m_parent{parent},
+  m_frozen{false}
+{
+  BUCKET_ASSERT(parent->m_frozen);
+  BUCKET_ASSERT(!scope.empty() && scope.front() == '/' && scope.back() == '/');
+}
+
+SymbolTable::~SymbolTable()
+{
+  for (auto& item : m_map)
+    destroyEntry(item.second);
+}
+
+void SymbolTable::freeze() noexcept
+{
+  BUCKET_ASSERT(m_unnamed_scopes.empty());
+  m_frozen = true;
+}
+
+bool SymbolTable::frozen() const noexcept
+{
+  return m_frozen;
+}
+
 void SymbolTable::pushScope(std::string_view name)
 {
+  BUCKET_ASSERT(!m_frozen);
   BUCKET_ASSERT(name.find('/') == std::string_view::npos);
+  if (name.empty())
+    m_unnamed_scopes.push_back({m_scoped_entries.size(), m_scoped_paths.mark()});
   m_scope += name;
   m_scope += '/';
 }
 
 void SymbolTable::popScope()
 {
+  BUCKET_ASSERT(!m_frozen);
   BUCKET_ASSERT(std::count(m_scope.begin(), m_scope.end(), '/') >= 2);
   BUCKET_ASSERT(m_scope.size() != 1);
   if (m_scope[m_scope.size() - 1] == '/' && m_scope[m_scope.size() - 2] == '/')
   {
-    std::vector<std::string_view> paths_to_delete;
-    for (auto& item : m_map)
-      if (boost::starts_with(item.first, m_scope))
-        paths_to_delete.push_back(item.first);
-    for (auto path : paths_to_delete)
-      m_map.erase(m_map.find(path));
+    BUCKET_ASSERT(!m_unnamed_scopes.empty());
+    auto scope = m_unnamed_scopes.back();
+    m_unnamed_scopes.pop_back();
+    while (m_scoped_entries.size() != scope.first_entry) {
+      auto entry = m_scoped_entries.back();
+      m_scoped_entries.pop_back();
+      m_map.erase(entry->path());
+      destroyEntry(entry);
+    }
+    m_scoped_paths.release(scope.paths);
     m_scope.pop_back();
   }
   else {
@@ -58,53 +109,107 @@ SymbolTable::Entry* SymbolTable::lookup(std::string_view name)
 
 }
 
+SymbolTable::Entry* SymbolTable::find(std::string_view path)
+{
+  auto iter = m_map.find(path);
+  if (iter != m_map.end())
+    return iter->second;
+  return m_parent ? m_parent->find(path) : nullptr;
+}
+
 SymbolTable::Entry* SymbolTable::lookup(std::string_view scope,
   std::string_view name)
 {
-  BUCKET_ASSERT(scope.size() != 0 && scope[scope.size() - 1] == '/');
-  std::string lookup_name{scope};
-  lookup_name += name;
+  BUCKET_ASSERT(scope.size() != 0 && scope[0] == '/');
+  // Paths are almost always short enough to be built on the stack.
+  boost::container::small_vector<char, 128> lookup_name{scope.begin(),
+    scope.end()};
+  if (lookup_name.back() != '/')
+    lookup_name.push_back('/');
+  lookup_name.insert(lookup_name.end(), name.begin(), name.end());
   while (true) {
-    auto iter = m_map.find(lookup_name);
-    if (iter != m_map.end())
-      return iter->second.get();
-    auto name_index = lookup_name.find_last_of('/');
+    if (auto entry = find(std::string_view(lookup_name.data(),
+      lookup_name.size())))
+      return entry;
+    auto lookup_name_view = std::string_view(lookup_name.data(),
+      lookup_name.size());
+    auto name_index = lookup_name_view.find_last_of('/');
     if (name_index == 0)
       return nullptr;
-    auto scope_index = lookup_name.find_last_of('/', name_index - 1);
+    auto scope_index = lookup_name_view.find_last_of('/', name_index - 1);
     auto new_length = lookup_name.size() - (name_index - scope_index);
     for (auto i = scope_index + 1; i != new_length; ++i)
       lookup_name[i] = lookup_name[name_index + (i - scope_index)];
-    lookup_name.erase(new_length);
+    lookup_name.resize(new_length);
   }
 }
 
+template <typename T, typename... Args>
+T* SymbolTable::createEntry(std::string_view name, Args&&... args)
+{
+  BUCKET_ASSERT(name.find('/') == std::string_view::npos);
+  BUCKET_ASSERT(!m_frozen);
+  auto scoped = !m_unnamed_scopes.empty();
+  auto path = (scoped ? m_scoped_paths : m_paths).store(m_scope, name);
+  if (find(path))
+    throw make_error<CodeGeneratorError>(path, " already exists");
+  auto& pool = std::get<Pool<T>>(m_pools);
+  auto entry = new (pool.allocate()) T(path, std::forward<Args>(args)...);
+  try {
+    m_map.emplace(path, entry);
+    if (scoped)
+      m_scoped_entries.push_back(entry);
+  } catch (...) {
+    m_map.erase(path);
+    entry->~T();
+    pool.deallocate(entry);
+    throw;
+  }
+  return entry;
+}
+
+void SymbolTable::destroyEntry(Entry* entry) noexcept
+{
+  class Destroyer final : public Visitor {
+  public:
+    explicit Destroyer(SymbolTable& symbol_table)
+    : m_symbol_table{symbol_table}
+    {}
+  private:
+    SymbolTable& m_symbol_table;
+    void visit(Field* ptr) override {m_symbol_table.releaseEntry(ptr);}
+    void visit(Method* ptr) override {m_symbol_table.releaseEntry(ptr);}
+    void visit(Type* ptr) override {m_symbol_table.releaseEntry(ptr);}
+    void visit(Class* ptr) override {m_symbol_table.releaseEntry(ptr);}
+    void visit(Variable* ptr) override {m_symbol_table.releaseEntry(ptr);}
+  };
+  Destroyer destroyer{*this};
+  dispatch(entry, &destroyer);
+}
+
+template <typename T>
+void SymbolTable::releaseEntry(T* entry) noexcept
+{
+  entry->~T();
+  std::get<Pool<T>>(m_pools).deallocate(entry);
+}
+
 SymbolTable::Field* SymbolTable::createField(std::string_view name, Type* type)
 {
   BUCKET_ASSERT(type);
-  BUCKET_ASSERT(name.find('/') == std::string_view::npos);
-  std::string path{m_scope};
-  path += name;
-  std::unique_ptr<Field> field_uptr{new Field(std::move(path), type)};
-  auto field_ptr = field_uptr.get();
-  if (m_map.find(field_ptr->path()) != m_map.end())
-    throw make_error<CodeGeneratorError>(field_ptr->path(), " already exists");
-  m_map[field_ptr->path()] = std::move(field_uptr);
+  BUCKET_ASSERT(m_unnamed_scopes.empty());
+  auto field_ptr = createEntry<Field>(name, type);
+  m_fields.push_back(*field_ptr);
   return field_ptr;
 }
 
 SymbolTable::Method* SymbolTable::createMethod(std::string_view name,
   std::vector<Type*> argument_types, Type* return_type)
 {
-  BUCKET_ASSERT(name.find('/') == std::string_view::npos);
-  std::string path{m_scope};
-  path += name;
-  std::unique_ptr<Method> method_uptr{new Method(std::move(path),
-    std::move(argument_types), return_type)};
-  auto method_ptr = method_uptr.get();
-  if (m_map.find(method_ptr->path()) != m_map.end())
-    throw make_error<CodeGeneratorError>(method_ptr->path(), " already exists");
-  m_map[method_ptr->path()] = std::move(method_uptr);
+  BUCKET_ASSERT(m_unnamed_scopes.empty());
+  auto method_ptr = createEntry<Method>(name, std::move(argument_types),
+    return_type);
+  m_methods.push_back(*method_ptr);
   return method_ptr;
 }
 
@@ -112,59 +217,50 @@ SymbolTable::Type* SymbolTable::createType(std::string_view name,
   llvm::Type* llvm_type)
 {
   //BUCKET_ASSERT(llvm_type);
-  BUCKET_ASSERT(name.find('/') == std::string_view::npos);
-  std::string path{m_scope};
-  path += name;
-  std::unique_ptr<Type> type_uptr{new Type(std::move(path), llvm_type)};
-  auto type_ptr = type_uptr.get();
-  if (m_map.find(type_ptr->path()) != m_map.end())
-    throw make_error<CodeGeneratorError>(type_ptr->path(), " already exists");
-  m_map[type_ptr->path()] = std::move(type_uptr);
+  BUCKET_ASSERT(m_unnamed_scopes.empty());
+  auto type_ptr = createEntry<Type>(name, llvm_type);
+  m_types.push_back(*type_ptr);
   return type_ptr;
 }
 
 SymbolTable::Class* SymbolTable::createClass(std::string_view name)
 {
-  BUCKET_ASSERT(name.find('/') == std::string_view::npos);
-  std::string path{m_scope};
-  path += name;
-  std::unique_ptr<Class> class_uptr{new Class(std::move(path))};
-  auto class_ptr = class_uptr.get();
-  if (m_map.find(class_ptr->path()) != m_map.end())
-    throw make_error<CodeGeneratorError>(class_ptr->path(), " already exists");
-  m_map[class_ptr->path()] = std::move(class_uptr);
+  BUCKET_ASSERT(m_unnamed_scopes.empty());
+  auto class_ptr = createEntry<Class>(name);
+  m_types.push_back(*class_ptr);
+  m_classes.push_back(*class_ptr);
   return class_ptr;
 }
 
 SymbolTable::Variable* SymbolTable::createVariable(std::string_view name,
   Type* type)
 {
-  BUCKET_ASSERT(name.find('/') == std::string_view::npos);
-  std::string path{m_scope};
-  path += name;
-  std::unique_ptr<Variable> variable_uptr{new Variable(std::move(path), type)};
-  auto variable_ptr = variable_uptr.get();
-  if (m_map.find(variable_ptr->path()) != m_map.end())
-    throw make_error<CodeGeneratorError>(variable_ptr->path(),
-      " already exists");
-  m_map[variable_ptr->path()] = std::move(variable_uptr);
-  return variable_ptr;
+  return createEntry<Variable>(name, type);
 }
 
 SymbolTable::Type* SymbolTable::getPointerType(Type* type)
 {
   BUCKET_ASSERT(type->m_llvm_type);
-  std::string reference_type_name{type->path()};
-  reference_type_name += '*';
-  auto iter = m_map.find(reference_type_name);
-  if (iter != m_map.end())
-    return boost::polymorphic_downcast<Type*>(iter->second.get());
-  auto reference_class_unique_pointer = std::unique_ptr<Type>(new Type{
-    std::move(reference_type_name), type->m_llvm_type->getPointerTo()});
-  auto reference_class_pointer = reference_class_unique_pointer.get();
-  BUCKET_ASSERT(m_map.find(reference_class_pointer->path()) == m_map.end());
-  m_map[reference_class_pointer->path()] = std::move(
-    reference_class_unique_pointer);
+  BUCKET_ASSERT(type->path().find("//") == std::string_view::npos);
+  boost::container::small_vector<char, 128> reference_type_name{
+    type->path().begin(), type->path().end()};
+  reference_type_name.push_back('*');
+  if (auto entry = find(std::string_view(reference_type_name.data(),
+    reference_type_name.size())))
+    return boost::polymorphic_downcast<Type*>(entry);
+  BUCKET_ASSERT(!m_frozen);
+  auto path = m_paths.store(type->path(), "*");
+  auto& pool = std::get<Pool<Type>>(m_pools);
+  auto reference_class_pointer = new (pool.allocate()) Type{path,
+    type->m_llvm_type->getPointerTo()};
+  try {
+    m_map.emplace(path, reference_class_pointer);
+  } catch (...) {
+    reference_class_pointer->~Type();
+    pool.deallocate(reference_class_pointer);
+    throw;
+  }
+  m_types.push_back(*reference_class_pointer);
   return reference_class_pointer;
 }
 
@@ -193,8 +289,9 @@ template <> SymbolTable::Entry* SymbolTable::gotoName<SymbolTable::Entry*>(
 template <>  SymbolTable::Entry* SymbolTable::gotoPath<SymbolTable::Entry*>(
   std::string_view path)
 {
-  BUCKET_ASSERT(m_map.find(path) != m_map.end());
-  return m_map[path].get();
+  auto entry = find(path);
+  BUCKET_ASSERT(entry);
+  return entry;
 }
 
 void SymbolTable::Visitor::visit(Entry*) {BUCKET_UNREACHABLE();}
@@ -229,8 +326,8 @@ void SymbolTable::Entry::receive(Visitor* visitor)
   visitor->visit(this);
 }
 
-SymbolTable::Entry::Entry(std::string path)
-: m_path{std::move(path)}
+SymbolTable::Entry::Entry(std::string_view path) noexcept
+: m_path{path}
 {}
 
 void SymbolTable::Field::receive(Visitor* visitor)
@@ -238,8 +335,8 @@ void SymbolTable::Field::receive(Visitor* visitor)
   visitor->visit(this);
 }
 
-SymbolTable::Field::Field(std::string path, Type* type) noexcept
-: Entry{std::move(path)}, m_type{type}
+SymbolTable::Field::Field(std::string_view path, Type* type) noexcept
+: Entry{path}, m_type{type}
 {
   BUCKET_ASSERT(m_type);
 }
@@ -249,10 +346,11 @@ void SymbolTable::Method::receive(Visitor* visitor)
   visitor->visit(this);
 }
 
-SymbolTable::Method::Method(std::string path, std::vector<Type*> argument_types,
-  Type* return_type) noexcept
-: Entry{std::move(path)},
+SymbolTable::Method::Method(std::string_view path,
+  std::vector<Type*> argument_types, Type* return_type) noexcept
+: Entry{path},
   m_llvm_function{nullptr},
+  m_lowering{nullptr},
   m_argument_types{std::move(argument_types)},
   m_return_type{return_type}
 {}
@@ -262,8 +360,8 @@ void SymbolTable::Type::receive(Visitor* visitor)
   visitor->visit(this);
 }
 
-SymbolTable::Type::Type(std::string path, llvm::Type* llvm_type) noexcept
-: Entry{std::move(path)}, m_llvm_type{llvm_type}
+SymbolTable::Type::Type(std::string_view path, llvm::Type* llvm_type) noexcept
+: Entry{path}, m_llvm_type{llvm_type}
 {}
 
 void SymbolTable::Class::receive(Visitor* visitor)
@@ -271,8 +369,8 @@ void SymbolTable::Class::receive(Visitor* visitor)
   visitor->visit(this);
 }
 
-SymbolTable::Class::Class(std::string path) noexcept
-: Type{std::move(path), nullptr}
+SymbolTable::Class::Class(std::string_view path) noexcept
+: Type{path, nullptr}
 {}
 
 void SymbolTable::Variable::receive(Visitor* visitor)
@@ -280,8 +378,8 @@ void SymbolTable::Variable::receive(Visitor* visitor)
   visitor->visit(this);
 }
 
-SymbolTable::Variable::Variable(std::string path, Type* type) noexcept
-: Entry{std::move(path)},
+SymbolTable::Variable::Variable(std::string_view path, Type* type) noexcept
+: Entry{path},
   m_type{type}
 {}
 
@@ -294,3 +392,104 @@ SymbolTable::iterator SymbolTable::end()
 {
   return iterator(m_map.end());
 }
+
+SymbolTable::ClassIndex& SymbolTable::classes() noexcept
+{
+  return m_classes;
+}
+
+SymbolTable::MethodIndex& SymbolTable::methods() noexcept
+{
+  return m_methods;
+}
+
+SymbolTable::FieldIndex& SymbolTable::fields() noexcept
+{
+  return m_fields;
+}
+
+SymbolTable::TypeIndex& SymbolTable::types() noexcept
+{
+  return m_types;
+}
+
+SymbolTable::StringArena::StringArena() noexcept
+: m_chunks{},
+  m_chunk{0},
+  m_offset{0}
+{}
+
+std::string_view SymbolTable::StringArena::store(std::string_view first,
+  std::string_view second)
+{
+  auto size = first.size() + second.size();
+  if (m_chunk == m_chunks.size() || m_chunks[m_chunk].second - m_offset < size)
+  {
+    if (m_chunk != m_chunks.size())
+      ++m_chunk;
+    auto capacity = std::max(chunk_size, size);
+    if (m_chunk == m_chunks.size())
+      m_chunks.emplace_back(std::make_unique<char[]>(capacity), capacity);
+    else if (m_chunks[m_chunk].second < size)
+      m_chunks.emplace(m_chunks.begin() + m_chunk,
+        std::make_unique<char[]>(capacity), capacity);
+    m_offset = 0;
+  }
+  auto result = m_chunks[m_chunk].first.get() + m_offset;
+  std::copy(second.begin(), second.end(),
+    std::copy(first.begin(), first.end(), result));
+  m_offset += size;
+  return std::string_view(result, size);
+}
+
+SymbolTable::StringArena::Mark SymbolTable::StringArena::mark() const noexcept
+{
+  return Mark{m_chunk, m_offset};
+}
+
+void SymbolTable::StringArena::release(Mark mark) noexcept
+{
+  BUCKET_ASSERT(mark.first < m_chunk ||
+    (mark.first == m_chunk && mark.second <= m_offset));
+  m_chunk = mark.first;
+  m_offset = mark.second;
+}
+
+SymbolTable::NodeRecycler::NodeRecycler() noexcept
+: m_free{}
+{}
+
+SymbolTable::NodeRecycler::~NodeRecycler()
+{
+  for (auto block : m_free) {
+    while (block) {
+      auto next = block->next;
+      ::operator delete(block);
+      block = next;
+    }
+  }
+}
+
+void* SymbolTable::NodeRecycler::allocate(std::size_t size)
+{
+  auto size_class = (size - 1) / granularity;
+  if (size == 0 || size_class >= size_classes)
+    return ::operator new(size);
+  if (auto block = m_free[size_class]) {
+    m_free[size_class] = block->next;
+    return block;
+  }
+  return ::operator new((size_class + 1) * granularity);
+}
+
+void SymbolTable::NodeRecycler::deallocate(void* ptr, std::size_t size) noexcept
+{
+  auto size_class = (size - 1) / granularity;
+  if (size == 0 || size_class >= size_classes) {
+    ::operator delete(ptr);
+    return;
+  }
+  auto block = static_cast<Block*>(ptr);
+  block->next = m_free[size_class];
+  m_free[size_class] = block;
+}
@@ -14,14 +14,20 @@
 #define BUCKET_SYMBOL_TABLE_HXX
 
 #include "miscellaneous.hxx"
+#include "string_interner.hxx"
+#include <boost/intrusive/list.hpp>
 #include <boost/iterator/iterator_adaptor.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/polymorphic_cast.hpp>
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace ast {
@@ -29,9 +35,10 @@ namespace ast {
 }
 
 namespace llvm {
-  class AllocaInst;
   class Function;
+  class IRBuilderBase;
   class Type;
+  class Value;
 }
 
 class SymbolTable : private boost::noncopyable {
@@ -45,7 +52,24 @@ class SymbolTable : private boost::noncopyable {
 // current working directory in an operating system. Now to explain the extra
 // '/': while some scopes are named (e.g. a class) some are not (e.g. a for
 // loop) and so '/boo/baz/bar//foo' means 'foo' is in an unnamed scope inside
-// '/boo/baz/bar'. Leaving an unnamed scope deletes everything in it.
+// '/boo/baz/bar'. Leaving an unnamed scope deletes everything in it. Besides
+// the hash table, every class, method, field and type is also linked into a
+// list of entries of its kind, in the order in which the entries were created,
+// so that passes which only care about one kind of entry don't have to walk
+// (and sym_cast) the whole table. Entries, their paths and the hash table's
+// nodes are all allocated from memory owned by the symbol table which is
+// recycled when an unnamed scope is popped, so that creating and deleting
+// temporaries (which happens for every block of every method) doesn't go
+// through malloc.
+//
+// Once every declaration has been resolved the symbol table can be frozen,
+// after which neither entries can be added to it nor its scope be changed, so
+// nothing modifies it anymore and any number of threads may look things up in
+// it at the same time without locking. Method bodies are analyzed in overlays:
+// a symbol table constructed on top of a frozen parent, in a scope of its own,
+// holds only the entries created through it (variables, mostly) and falls back
+// to the parent when a path isn't one of its own. Every thread should use its
+// own overlay.
 
 public:
 
@@ -58,6 +82,18 @@ public:
 
   SymbolTable();
 
+  SymbolTable(SymbolTable* parent, std::string_view scope);
+  // Creates an overlay on top of a frozen symbol table, which starts out in the
+  // given scope (e.g. "/main/" for the methods of the class main).
+
+  ~SymbolTable();
+
+  void freeze() noexcept;
+  bool frozen() const noexcept;
+  // After freeze() has been called entries can no longer be created in the
+  // symbol table and scopes can no longer be pushed or popped (overlays have
+  // scopes of their own).
+
   void pushScope(std::string_view name = "");
   void popScope();
   // Used to enter and exit scopes. Calling pushScope() with no arguments pushes
@@ -66,7 +102,14 @@ public:
 
   Entry* lookup(std::string_view name);
   Entry* lookup(std::string_view scope, std::string_view name);
-  // Looks up a name either in the current scope or in some specified scope.
+  // Looks up a name either in the current scope or in some specified scope. The
+  // scope may be given with or without a trailing '/', so the path of an entry
+  // can be passed directly to look up a name inside of it.
+
+  Entry* find(std::string_view path);
+  // Looks up an entry by its full path without searching enclosing scopes.
+  // Returns nullptr if there is no such entry. Like every other lookup this
+  // searches the parent of an overlay as well.
 
   template <typename T>
   T gotoName(std::string_view name)
@@ -98,7 +141,8 @@ public:
   Class* createClass(std::string_view name);
   Variable* createVariable(std::string_view name, Type* type);
   // These are the only way to create entries in the SymbolTable (well, except
-  // for getReferenceType). They create an entry in the current scope.
+  // for getPointerType). They create an entry in the current scope. Types,
+  // classes, methods and fields may not be created inside an unnamed scope.
 
   Type* getPointerType(Type* type);
   // Gets a pointer type from a type. If the pointer type already exists in the
@@ -113,6 +157,133 @@ public:
 
 private:
 
+  struct ClassIndexTag;
+  struct MethodIndexTag;
+  struct FieldIndexTag;
+  struct TypeIndexTag;
+
+  template <typename Tag>
+  using IndexHook = boost::intrusive::list_base_hook<
+    boost::intrusive::tag<Tag>,
+    boost::intrusive::link_mode<boost::intrusive::auto_unlink>
+  >;
+  // Entries are linked into the per kind lists through these hooks. The hooks
+  // unlink themselves when an entry is destroyed, so deleting an entry (e.g.
+  // when an unnamed scope is popped) never leaves a dangling list node.
+
+  template <typename EntryType, typename Tag>
+  using Index = boost::intrusive::list<
+    EntryType,
+    boost::intrusive::base_hook<IndexHook<Tag>>,
+    boost::intrusive::constant_time_size<false>
+  >;
+
+  template <typename T>
+  class Pool : private boost::noncopyable {
+  // Hands out uninitialized storage for objects of type T. The storage is
+  // carved out of slabs which hold many objects each, and storage that is given
+  // back is put on a free list so that the next allocation can reuse it. Slabs
+  // are only freed when the pool is destroyed.
+  public:
+    Pool() noexcept
+    : m_free{nullptr}, m_remaining{0}
+    {}
+    void* allocate()
+    {
+      if (auto slot = m_free) {
+        m_free = slot->next;
+        return slot;
+      }
+      if (!m_remaining) {
+        m_slabs.push_back(std::make_unique<Slot[]>(slab_size));
+        m_remaining = slab_size;
+      }
+      return &m_slabs.back()[slab_size - m_remaining--];
+    }
+    void deallocate(void* ptr) noexcept
+    {
+      auto slot = static_cast<Slot*>(ptr);
+      slot->next = m_free;
+      m_free = slot;
+    }
+  private:
+    static constexpr std::size_t slab_size = 64;
+    union Slot {
+      Slot* next;
+      std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+    };
+    std::vector<std::unique_ptr<Slot[]>> m_slabs;
+    Slot* m_free;
+    std::size_t m_remaining;
+  };
+
+  class StringArena : private boost::noncopyable {
+  // Stores strings back to back in large chunks. Strings can't be freed one by
+  // one, but the arena can be rolled back to the state it was in when mark()
+  // was called, after which its chunks are reused for new strings.
+  public:
+    using Mark = std::pair<std::size_t, std::size_t>;
+    StringArena() noexcept;
+    std::string_view store(std::string_view first,
+      std::string_view second = {});
+    // Copies the concatenation of first and second into the arena.
+    Mark mark() const noexcept;
+    void release(Mark mark) noexcept;
+  private:
+    static constexpr std::size_t chunk_size = 4096;
+    std::vector<std::pair<std::unique_ptr<char[]>, std::size_t>> m_chunks;
+    std::size_t m_chunk;
+    std::size_t m_offset;
+  };
+
+  class NodeRecycler : private boost::noncopyable {
+  // Backs the allocator of the hash table. Small blocks that are freed are kept
+  // on free lists (one per size class) and handed out again instead of being
+  // returned to the heap.
+  public:
+    NodeRecycler() noexcept;
+    ~NodeRecycler();
+    void* allocate(std::size_t size);
+    void deallocate(void* ptr, std::size_t size) noexcept;
+    static constexpr std::size_t granularity = alignof(std::max_align_t);
+    static constexpr std::size_t size_classes = 8;
+  private:
+    struct Block {
+      Block* next;
+    };
+    Block* m_free[size_classes];
+  };
+
+  template <typename T>
+  class NodeAllocator {
+  public:
+    using value_type = T;
+    explicit NodeAllocator(NodeRecycler* recycler) noexcept
+    : m_recycler{recycler}
+    {}
+    template <typename U>
+    NodeAllocator(const NodeAllocator<U>& other) noexcept
+    : m_recycler{other.m_recycler}
+    {}
+    T* allocate(std::size_t n)
+    {
+      return static_cast<T*>(m_recycler->allocate(n * sizeof(T)));
+    }
+    void deallocate(T* ptr, std::size_t n) noexcept
+    {
+      m_recycler->deallocate(ptr, n * sizeof(T));
+    }
+    friend bool operator==(const NodeAllocator& a, const NodeAllocator& b)
+    {
+      return a.m_recycler == b.m_recycler;
+    }
+    friend bool operator!=(const NodeAllocator& a, const NodeAllocator& b)
+    {
+      return a.m_recycler != b.m_recycler;
+    }
+    NodeRecycler* m_recycler;
+  };
+
   class Visitor {
   public:
     virtual ~Visitor() = default;
@@ -140,13 +311,14 @@ public:
     // returns the last part of the entry's path (e.g. /foo/bar/baz -> baz)
     std::string_view parent() const noexcept;
   protected:
-    explicit Entry(std::string path);
+    explicit Entry(std::string_view path) noexcept;
   private:
-    const std::string m_path;
+    const std::string_view m_path;
+    // Points into one of the symbol table's string arenas.
     virtual void receive(Visitor* visitor);
   };
 
-  class Field final : public Entry {
+  class Field final : public Entry, public IndexHook<FieldIndexTag> {
   // A member variable of a class
   template <typename EntryType, typename VisitorType>
   friend void dispatch(EntryType*, VisitorType*);
@@ -154,31 +326,39 @@ public:
   public:
     Type* const m_type;
   private:
-    Field(std::string path, Type* type) noexcept;
+    Field(std::string_view path, Type* type) noexcept;
     void receive(Visitor* visitor) override;
   };
 
-  class Method final : public Entry {
+  class Method final : public Entry, public IndexHook<MethodIndexTag> {
   // Contains a list of argument types and a return type, as well as an
   // llvm::Function pointer. Note that the list of arguments does not include
   // the implicit this* argument given to non-empty classes. The arguments list
   // and the return type are set on initialization and cannot be changed but
   // the llvm::Function pointer can be changed after initialization with the
-  // setter method.
+  // setter method. Built-in methods may also have a lowering, which emits the
+  // instructions implementing the method in place of a call. A lowering is
+  // given the value of the receiver followed by the values of the arguments.
+  // The decorators are the names of the '@' decorators of the method (like
+  // "inline"), which the code generator turns into function attributes.
   template <typename EntryType, typename VisitorType>
   friend void dispatch(EntryType*, VisitorType*);
   friend class SymbolTable;
   public:
+    using Lowering = llvm::Value* (*)(llvm::IRBuilderBase& ir_builder,
+      const std::vector<llvm::Value*>& arguments);
     llvm::Function* m_llvm_function;
+    Lowering m_lowering;
+    std::vector<InternedString> m_decorators;
     const std::vector<Type*> m_argument_types;
     Type* const m_return_type;
   private:
-    Method(std::string path, std::vector<Type*> argument_types,
+    Method(std::string_view path, std::vector<Type*> argument_types,
       Type* return_type) noexcept;
     void receive(Visitor* visitor) override;
   };
 
-  class Type : public Entry {
+  class Type : public Entry, public IndexHook<TypeIndexTag> {
   // Contains a llvm::Type pointer
   template <typename EntryType, typename VisitorType>
   friend void dispatch(EntryType*, VisitorType*);
@@ -186,31 +366,32 @@ public:
   public:
     llvm::Type* m_llvm_type;
   protected:
-    Type(std::string path, llvm::Type* llvm_type) noexcept;
+    Type(std::string_view path, llvm::Type* llvm_type) noexcept;
   private:
     void receive(Visitor* visitor) override;
   };
 
-  class Class final : public Type {
+  class Class final : public Type, public IndexHook<ClassIndexTag> {
   template <typename EntryType, typename VisitorType>
   friend void dispatch(EntryType*, VisitorType*);
   friend class SymbolTable;
   public:
     std::vector<Field*> m_fields;
   private:
-    Class(std::string path) noexcept;
+    Class(std::string_view path) noexcept;
     void receive(Visitor* visitor) override;
   };
 
   class Variable final : public Entry {
+  // A local variable. Variables have no storage of their own: the code
+  // generator keeps track of their values in SSA form.
   template <typename EntryType, typename VisitorType>
   friend void dispatch(EntryType*, VisitorType*);
   friend class SymbolTable;
   public:
-    llvm::AllocaInst* m_llvm_value;
     Type* const m_type;
   private:
-    Variable(std::string path, Type* type) noexcept;
+    Variable(std::string_view path, Type* type) noexcept;
     void receive(Visitor* visitor) override;
   };
 
@@ -269,9 +450,13 @@ public:
 
 private:
 
+    using Map = std::unordered_map<std::string_view, Entry*,
+      std::hash<std::string_view>, std::equal_to<std::string_view>,
+      NodeAllocator<std::pair<const std::string_view, Entry*>>>;
+
     class iterator : public boost::iterator_adaptor<
       iterator,
-      std::unordered_map<std::string_view, std::unique_ptr<Entry>>::iterator,
+      Map::iterator,
       Entry*,
       boost::forward_traversal_tag,
       Entry*
@@ -283,18 +468,73 @@ private:
       {}
     private:
       friend class boost::iterator_core_access;
-      Entry* dereference() const {return this->base()->second.get();}
+      Entry* dereference() const {return this->base()->second;}
     };
 
-    std::unordered_map<std::string_view, std::unique_ptr<Entry>> m_map;
+    struct UnnamedScope {
+      std::size_t first_entry;
+      StringArena::Mark paths;
+    };
+    // Remembers what to free when an unnamed scope is popped: every entry in
+    // m_scoped_entries from first_entry onwards and every path stored in
+    // m_scoped_paths since the scope was pushed.
+
+    template <typename T, typename... Args>
+    T* createEntry(std::string_view name, Args&&... args);
+    void destroyEntry(Entry* entry) noexcept;
+    template <typename T>
+    void releaseEntry(T* entry) noexcept;
+
+    NodeRecycler m_node_recycler;
+
+    std::tuple<Pool<Field>, Pool<Method>, Pool<Type>, Pool<Class>,
+      Pool<Variable>> m_pools;
+
+    StringArena m_paths;
+    StringArena m_scoped_paths;
+    // Paths of entries outside of any unnamed scope are never freed, paths of
+    // entries inside unnamed scopes are freed when the scope is popped.
+
+    std::vector<UnnamedScope> m_unnamed_scopes;
+    std::vector<Entry*> m_scoped_entries;
+
+    Map m_map;
 
     std::string m_scope;
 
+    SymbolTable* const m_parent;
+    bool m_frozen;
+
+public:
+
+  using ClassIndex = Index<Class, ClassIndexTag>;
+  using MethodIndex = Index<Method, MethodIndexTag>;
+  using FieldIndex = Index<Field, FieldIndexTag>;
+  using TypeIndex = Index<Type, TypeIndexTag>;
+
+private:
+
+    ClassIndex m_classes;
+    MethodIndex m_methods;
+    FieldIndex m_fields;
+    TypeIndex m_types;
+
 public:
 
   iterator begin();
 
   iterator end();
+  // Iterates over every entry in the symbol table in no particular order. The
+  // entries of an overlay's parent are not included.
+
+  ClassIndex& classes() noexcept;
+  MethodIndex& methods() noexcept;
+  FieldIndex& fields() noexcept;
+  TypeIndex& types() noexcept;
+  // Iterates over all entries of a single kind in the order in which they were
+  // created. Note that classes are types, so they appear in types() as well.
+  // Creating new entries while iterating is fine, but the new entries will be
+  // visited if they are of the kind being iterated over.
 
 };
 
@@ -0,0 +1,57 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#include "target.hxx"
+#include <algorithm>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Host.h>
+#include <vector>
+
+Target string2Target(std::string_view arch, std::string_view tune)
+{
+  Target target;
+  if (arch == "native") {
+    target.cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+      // sorted, so that the same host always gets the same string
+      std::vector<std::string> features;
+      for (auto& feature : host_features)
+        features.push_back((feature.getValue() ? "+" : "-")
+          + feature.getKey().str());
+      std::sort(features.begin(), features.end());
+      for (auto& feature : features) {
+        if (!target.features.empty())
+          target.features += ',';
+        target.features += feature;
+      }
+    }
+  }
+  else {
+    target.cpu = std::string(arch);
+  }
+  if (tune == "native")
+    target.tune_cpu = llvm::sys::getHostCPUName().str();
+  else
+    target.tune_cpu = std::string(tune);
+  return target;
+}
+
+std::string target2String(const Target& target)
+{
+  auto string = "-march=" + target.cpu;
+  if (!target.features.empty())
+    string += " -mattr=" + target.features;
+  if (!target.tune_cpu.empty())
+    string += " -mtune=" + target.tune_cpu;
+  return string;
+}
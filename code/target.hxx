@@ -0,0 +1,42 @@
+// Copyright (C) 2020  Claire Hansel
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+#ifndef BUCKET_TARGET_HXX
+#define BUCKET_TARGET_HXX
+
+#include <string>
+#include <string_view>
+
+struct Target {
+// The processor the generated code is compiled for, using llvm's names: the
+// cpu whose instructions may be used, extra features on top of the ones the
+// cpu implies (like "+avx2,+fma") and the cpu to tune the code for. An empty
+// tune_cpu tunes for cpu.
+
+  std::string cpu = "generic";
+  std::string features;
+  std::string tune_cpu;
+
+};
+
+Target string2Target(std::string_view arch, std::string_view tune);
+// Converts the arguments of the -march and -mtune options to a target. The cpu
+// "native" stands for the processor of the host, in which case the features
+// are the ones the host actually has (so a cpu model which is sold with some of
+// its features disabled is handled correctly). An empty tune tunes for arch.
+// Whether the cpus exist is checked by the code generator.
+
+std::string target2String(const Target& target);
+// Describes a target in the syntax of the command line, e.g. for the keys of
+// caches.
+
+#endif
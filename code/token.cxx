@@ -141,7 +141,7 @@ Token::Token()
 {}
 
 Token Token::createIdentifier(
-  std::string value,
+  InternedString value,
   SourceFile::iterator range_begin,
   SourceFile::iterator range_end)
 {
@@ -253,11 +253,11 @@ Token::operator bool() const
   return !static_cast<bool>(std::get_if<9>(&m_value));
 }
 
-std::optional<std::string> Token::getIdentifier() const
+std::optional<InternedString> Token::getIdentifier() const
 {
-  const std::string* ptr = std::get_if<1>(&m_value);
+  const InternedString* ptr = std::get_if<1>(&m_value);
   if (ptr)
-    return std::optional<std::string>(*ptr);
+    return std::optional<InternedString>(*ptr);
   else
     return std::nullopt;
 }
@@ -14,6 +14,7 @@
 #define BUCKET_TOKEN_HXX
 
 #include "source_file.hxx"
+#include "string_interner.hxx"
 #include <cstdint>
 #include <optional>
 #include <ostream>
@@ -59,7 +60,7 @@ public:
   // Default constructor which constructs a null token
 
   static Token createIdentifier(
-    std::string value,
+    InternedString value,
     SourceFile::iterator begin,
     SourceFile::iterator end);
   static Token createKeyword(
@@ -103,7 +104,7 @@ public:
   operator bool() const;
   // Returns false if the token is a null token and true if it is not
 
-  std::optional<std::string> getIdentifier() const;
+  std::optional<InternedString> getIdentifier() const;
   std::optional<Keyword> getKeyword() const;
   std::optional<Symbol> getSymbol() const;
   std::optional<std::int64_t> getIntegerLiteral() const;
@@ -122,7 +123,7 @@ private:
 
   std::variant<
     std::monostate, // Index 0: Null Token
-    std::string,    // Index 1: Identifier Token
+    InternedString, // Index 1: Identifier Token
     Keyword,        // Index 2: Keyword Token
     Symbol,         // Index 3: Symbol Token
     std::int64_t,   // Index 4: Integer Literal Token
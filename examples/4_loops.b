@@ -1,6 +1,7 @@
 class main
   method main(): bool
     x = 3
+    @nounroll
     do
       x = x + 1
       if x > 10
@@ -9,6 +10,7 @@ class main
       x.print
     end
     y = x - 10
+    @unroll(2)
     for y < 10
       if y == 0
         (0.01).print